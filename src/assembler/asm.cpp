@@ -2,21 +2,104 @@
 
 #include <iostream>
 
-void Assembler::scanLabels() {
-	std::string line;
+namespace {
+	/// FNV-1a, enough to tell whether a section's source changed.
+	u64 hashLines(const std::vector<std::string>& lines) {
+		u64 hash = 0xcbf29ce484222325ull;
+		for (const std::string& line: lines) {
+			for (const char c: line) {
+				hash = (hash ^ static_cast<u8>(c)) * 0x100000001b3ull;
+			}
+			hash = (hash ^ '\n') * 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	template <typename T>
+	void writeRaw(std::ofstream& out, const T& value) {
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
 
-	do {
-		std::getline(fileIn, line);
+	template <typename T>
+	bool readRaw(std::ifstream& in, T& value) {
+		return static_cast<bool>(
+			in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	void writeString(std::ofstream& out, const std::string& str) {
+		writeRaw<u32>(out, str.size());
+		out.write(str.data(), str.size());
+	}
 
+	bool readString(std::ifstream& in, std::string& str) {
+		u32 len;
+		if (!readRaw(in, len) || len > Assembler::MAX_LINE_LENGTH) return false;
+		str.resize(len);
+		return static_cast<bool>(in.read(str.data(), len));
+	}
+}
+
+Label* Assembler::getLabel(const std::string& labelText) {
+	if (allowExternal) {
+		return &allLabels.try_emplace(labelText, labelText).first->second;
+	}
+
+	// A section reused from the cache may still jump to a label that has
+	// since been removed from the source.
+	auto it = allLabels.find(labelText);
+	if (it == allLabels.end()) {
+		throw BException("Cannot assemble - label %s is not defined.",
+		                 labelText.c_str());
+	}
+	return &it->second;
+}
+
+bool Assembler::isLabel(const std::string& line) {
+	// Jumps name their label with its colon too, so only a lone word counts.
+	return line.back() == ':' && line.find(' ') == std::string::npos;
+}
+
+bool Assembler::nextLine(std::string& line) {
+	while (std::getline(fileIn, line)) {
 		if (line.length() > MAX_LINE_LENGTH) {
 			throw BException("Cannot assemble line %s - exceeds maximum length "
 							 "of %u", line.c_str(), MAX_LINE_LENGTH);
 		}
-		
-		if (line.back() == ':') {
+
+		const size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos) continue;
+
+		const size_t last = line.find_last_not_of(" \t\r");
+		line = line.substr(first, last - first + 1);
+		return true;
+	}
+
+	return false;
+}
+
+std::pair<std::string, std::string> Assembler::splitInstr(
+  const std::string& line) {
+	auto itSpace = std::find(line.begin(), line.end(), ' ');
+
+	if (itSpace == line.end()) {
+		throw BException("Cannot assemble line %s - expected "
+						 "instruction to have an operand part and "
+						 "a value part, separated by a space.",
+						 line.c_str());
+	}
+
+	return {std::string(line.begin(), itSpace),
+			std::string(itSpace + 1, line.end())};
+}
+
+void Assembler::scanLabels() {
+	std::string line;
+
+	while (nextLine(line)) {
+		if (isLabel(line)) {
 			allLabels.emplace(line, line);
 		}
-	} while (line != "");
+	}
 
 	// We'll need to scan the file again.
 	fileIn.clear();
@@ -26,30 +109,18 @@ void Assembler::scanLabels() {
 void Assembler::scanInstructions() {
 	std::string line;
 
-	do {
-		std::getline(fileIn, line);
-
-		if (line.back() == ':') {
+	while (nextLine(line)) {
+		if (isLabel(line)) {
 			allLines.emplace_back(
 				std::in_place_type<Label*>, getLabel(line));
 		} else {
-			auto itSpace = std::find(line.begin(), line.end(), ' ');
-
-			if (itSpace == line.end()) {
-				throw BException("Cannot assemble line %s - expected "
-								 "instruction to have an operand part and "
-								 "a value part, separated by a space.", 
-								 line.c_str());
-			}
-
-			std::string instrDesc(line.begin(), itSpace);
-			std::string instrVal(itSpace + 1, line.end());
+			const auto [instrDesc, instrVal] = splitInstr(line);
 
 			allInstr.emplace_back(instrDesc, instrVal);
 			allLines.emplace_back(
 				std::in_place_type<Instruction*>, &allInstr.back());
 		}
-	} while (line != "");
+	}
 }
 
 void Assembler::calculateOffsets() {
@@ -82,9 +153,215 @@ void Assembler::assemble() {
 }
 
 void Assembler::run() {
-    Instruction::assemblerPtr = std::unique_ptr<Assembler>(this);
-    scanLabels();
-    scanInstructions();
-    calculateOffsets();
-    assemble();
+	Instruction::assemblerPtr = this;
+	scanLabels();
+	scanInstructions();
+	calculateOffsets();
+	assemble();
+	fileOut.flush();
+}
+
+std::vector<std::pair<std::string, std::vector<std::string>>>
+Assembler::splitSections() {
+	std::vector<std::pair<std::string, std::vector<std::string>>> sections;
+	sections.emplace_back();
+
+	std::string line;
+	while (nextLine(line)) {
+		if (isLabel(line)) {
+			allLabels.emplace(line, line);
+			sections.emplace_back(line, std::vector<std::string>());
+		} else {
+			sections.back().second.push_back(line);
+		}
+	}
+
+	return sections;
+}
+
+Section Assembler::encodeSection(
+  const std::string& label,
+  const std::vector<std::string>& lines,
+  const u64 hash) {
+	Section section{label, hash, {}, {}, true};
+
+	for (const std::string& line: lines) {
+		const auto [instrDesc, instrVal] = splitInstr(line);
+		const Instruction instr(instrDesc, instrVal);
+
+		if (instr.isJump()) {
+			section.relocs.push_back(
+				{static_cast<u32>(section.bytes.size()),
+				 instr.instrCode, instr.instrVal.labelPtr->text});
+			section.bytes.insert(section.bytes.end(), JUMP_SIZE, 0);
+		} else {
+			const std::vector<u8> assembledInstr = instr.assemble(0);
+			section.bytes.insert(section.bytes.end(),
+				assembledInstr.begin(), assembledInstr.end());
+		}
+
+		section.fallsThrough = !(instr.instrCode == jCode ||
+			(instr.isOperation() && instr.instrVal.opCode == operMap.at("ret")));
+	}
+
+	return section;
+}
+
+Assembler::IncrementalStats Assembler::runIncremental(const char *cachePath) {
+	Instruction::assemblerPtr = this;
+
+	const auto sourceSections = splitSections();
+	std::map<std::string, Section> cache = loadCache(cachePath);
+
+	// Reuse or rebuild every section, then lay them out back to back. Labels
+	// always start a section, so their offsets are the section offsets.
+	IncrementalStats stats{0, 0};
+	std::vector<Section> sections;
+	sections.reserve(sourceSections.size());
+
+	u32 byteOffset = 0;
+	for (const auto& [label, lines]: sourceSections) {
+		const u64 hash = hashLines(lines);
+		auto it = cache.find(label);
+
+		if (it != cache.end() && it->second.hash == hash) {
+			sections.push_back(std::move(it->second));
+			stats.reused++;
+		} else {
+			sections.push_back(encodeSection(label, lines, hash));
+			stats.rebuilt++;
+		}
+
+		if (!label.empty()) allLabels.at(label).offset = byteOffset;
+		byteOffset += sections.back().bytes.size();
+	}
+
+	// Splice the sections together and point every jump at the current
+	// offset of its label. Each patch rewrites one fixed-size slot, so
+	// patching all of them costs a single pass over the relocation tables.
+	std::vector<u8> output;
+	output.reserve(byteOffset);
+
+	for (const Section& section: sections) {
+		const u32 sectionOffset = output.size();
+		output.insert(output.end(), section.bytes.begin(), section.bytes.end());
+
+		for (const Reloc& reloc: section.relocs) {
+			const u32 slotOffset = sectionOffset + reloc.offset;
+			const u32 delta = getLabel(reloc.label)->offset -
+				(slotOffset + JUMP_SIZE);
+
+			std::vector<u8> jumpSeq;
+			genJumpSeq(reloc.instrCode, delta, jumpSeq);
+			std::copy(jumpSeq.begin(), jumpSeq.end(), &output[slotOffset]);
+		}
+	}
+
+	fileOut.write(reinterpret_cast<const char*>(output.data()), output.size());
+	fileOut.flush();
+
+	std::ofstream cacheOut(cachePath, std::ios::binary | std::ios::trunc);
+	writeSections(cacheOut, ObjectFormat::CACHE_MAGIC, sections);
+	if (!cacheOut) {
+		throw BException("Cannot write assembly cache to %s.", cachePath);
+	}
+
+	return stats;
+}
+
+void Assembler::runObject() {
+	Instruction::assemblerPtr = this;
+	allowExternal = true;
+
+	std::vector<Section> sections;
+	for (const auto& [label, lines]: splitSections()) {
+		sections.push_back(encodeSection(label, lines, hashLines(lines)));
+	}
+
+	writeSections(fileOut, ObjectFormat::OBJECT_MAGIC, sections);
+	fileOut.flush();
+}
+
+std::map<std::string, Section> Assembler::loadCache(const char *cachePath) {
+	std::map<std::string, Section> cache;
+	std::ifstream in(cachePath, std::ios::binary | std::ios::ate);
+	const std::streamoff fileSize = in.tellg();
+	in.seekg(0);
+
+	// Sizes come from the file, so they are checked against what is left of
+	// it before anything is allocated for them.
+	auto bytesLeft = [&]() -> std::streamoff {
+		return fileSize - in.tellg();
+	};
+
+	u32 magic, version, count;
+	if (!readRaw(in, magic) || magic != ObjectFormat::CACHE_MAGIC ||
+		!readRaw(in, version) || version != ObjectFormat::VERSION ||
+		!readRaw(in, count)) {
+		return {};
+	}
+
+	for (u32 i = 0; i < count; ++i) {
+		Section section;
+		u32 size, relocCount;
+
+		u8 fallsThrough;
+		if (!readString(in, section.label) ||
+			!readRaw(in, section.hash) ||
+			!readRaw(in, fallsThrough) ||
+			!readRaw(in, size)) {
+			return {};
+		}
+		section.fallsThrough = fallsThrough;
+
+		if (size > bytesLeft()) return {};
+		section.bytes.resize(size);
+		if (!in.read(reinterpret_cast<char*>(section.bytes.data()), size) ||
+			!readRaw(in, relocCount)) {
+			return {};
+		}
+
+		// Each relocation takes an offset, an instruction code and a label
+		// length at least.
+		if (relocCount > bytesLeft() / (sizeof(u32) + sizeof(u8) + sizeof(u32)))
+			return {};
+		section.relocs.resize(relocCount);
+		for (Reloc& reloc: section.relocs) {
+			if (!readRaw(in, reloc.offset) ||
+				!readRaw(in, reloc.instrCode) ||
+				!readString(in, reloc.label) ||
+				reloc.offset > size || size - reloc.offset < JUMP_SIZE) {
+				return {};
+			}
+		}
+
+		cache.emplace(section.label, std::move(section));
+	}
+
+	return cache;
+}
+
+void Assembler::writeSections(
+  std::ofstream& out,
+  const u32 magic,
+  const std::vector<Section>& sections) {
+	writeRaw<u32>(out, magic);
+	writeRaw<u32>(out, ObjectFormat::VERSION);
+	writeRaw<u32>(out, sections.size());
+
+	for (const Section& section: sections) {
+		writeString(out, section.label);
+		writeRaw(out, section.hash);
+		writeRaw<u8>(out, section.fallsThrough);
+		writeRaw<u32>(out, section.bytes.size());
+		out.write(reinterpret_cast<const char*>(section.bytes.data()),
+				  section.bytes.size());
+
+		writeRaw<u32>(out, section.relocs.size());
+		for (const Reloc& reloc: section.relocs) {
+			writeRaw(out, reloc.offset);
+			writeRaw(out, reloc.instrCode);
+			writeString(out, reloc.label);
+		}
+	}
 }
@@ -3,6 +3,7 @@
 #include <array>
 #include <algorithm>
 #include <charconv>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <map>
@@ -24,6 +25,41 @@ class Instruction;
 
 typedef std::variant<Label*, Instruction*> Line;
 
+/// A jump slot inside assembled bytes that still has to be pointed at
+/// @label.
+struct Reloc {
+    u32 offset;
+    u8 instrCode;
+    std::string label;
+};
+
+/// A label-delimited run of source lines, assembled as a unit by
+/// Assembler::runIncremental and Assembler::runObject. Jump slots in @bytes
+/// are left zeroed and recorded in @relocs, which makes the bytes independent
+/// of where the section ends up in the output.
+struct Section {
+    std::string label;  // Empty for the lines before the first label.
+    u64 hash;
+    std::vector<u8> bytes;
+    std::vector<Reloc> relocs;
+    bool fallsThrough;  // False if it ends in j or ret.
+};
+
+/// Section caches and relocatable objects share one file format:
+/// |
+/// * header: u32 magic, u32 version, u32 section count
+/// * per section: label, u64 hash, u8 fallsThrough, u32 size, size bytes,
+/// |   u32 relocation count, relocations
+/// * per relocation: u32 offset, u8 instrCode, label
+/// |
+/// Labels are a u32 length followed by the characters. All integers are
+/// little-endian.
+namespace ObjectFormat {
+    constexpr u32 CACHE_MAGIC  = 0x4F434143; // "OCAC"
+    constexpr u32 OBJECT_MAGIC = 0x4F434F42; // "OCOB"
+    constexpr u32 VERSION      = 2;
+}
+
 class Assembler {
   friend class Instruction;
   friend class Label;
@@ -31,6 +67,16 @@ class Assembler {
   public: 
     static constexpr u8 MAX_LINE_LENGTH = 255;
 
+    /// Every jump is encoded in a slot of this many bytes - see
+    /// genJumpSeq.
+    static constexpr u32 JUMP_SIZE = 8;
+
+    /// Outcome of an incremental run.
+    struct IncrementalStats {
+        u32 reused;
+        u32 rebuilt;
+    };
+
     Assembler(const char *_fileIn, const char *_fileOut):
       fileIn(_fileIn),
       fileOut(_fileOut) {}
@@ -38,10 +84,18 @@ class Assembler {
     /// Run the assembler on the given input and output files.
     void run();
 
+    /// Like run, but only re-encodes sections whose source changed since
+    /// the last incremental run with the same @cachePath. Produces output
+    /// identical to run.
+    IncrementalStats runIncremental(const char *cachePath);
+
+    /// Assemble the input into a relocatable object for the linker. Labels
+    /// the input does not define are left for the linker to resolve against
+    /// other objects.
+    void runObject();
+
     /// Get a pointer to the Label object described by @labelText.
-    Label* getLabel(const std::string& labelText) { 
-        return &allLabels.at(labelText);
-    }
+    Label* getLabel(const std::string& labelText);
 
     /// Generate the proper prefix sequence for applying the immediate value
     /// @vImm to the instruction @instrCode, storing the result in @instrBuf.
@@ -49,17 +103,46 @@ class Assembler {
       const u8 instrCode, 
       const u32 vImm, 
       std::vector<u8>& instrBuf) {
-        if (vImm >= 16) genPrefixSeq(pfixCode, vImm >> 4, instrBuf);
-        else if (vImm < 0) genPrefixSeq(nfixCode, (~vImm) >> 4, instrBuf);
-        instrBuf.push_back(instrCode | (vImm & 0xF));
+        const int32_t sImm = static_cast<int32_t>(vImm);
+        if (sImm >= 16) genPrefixSeq(pfixCode, vImm >> 4, instrBuf);
+        else if (sImm < 0) genPrefixSeq(nfixCode, (~vImm) >> 4, instrBuf);
+        instrBuf.push_back((instrCode << 4) | (vImm & 0xF));
+    }
+
+    /// Generate a jump @instrCode over @delta bytes, counted from the end of
+    /// the jump, into exactly JUMP_SIZE bytes of @instrBuf.
+    ///
+    /// Assembling jump instructions is tricky as we are encoding the jump
+    /// length with pfix / nfix instructions. With interlocking jumps, the
+    /// number of instructions required to encode one jump can depend in a
+    /// circular way on the number of instructions required to encode other
+    /// jumps.
+    ///
+    /// The cleanest compromise is to encode each jump in a fixed number of
+    /// bytes. Eight is the simplest choice here, since it allows jumps in the
+    /// range [-2^31, 2^31 - 1]. The slot is padded at the front with
+    /// `pfix 0`, which leaves the operand register at zero, so the jump
+    /// itself is always the last byte of the slot.
+    static void genJumpSeq(
+      const u8 instrCode,
+      const u32 delta,
+      std::vector<u8>& instrBuf) {
+        std::vector<u8> jumpSeq;
+        genPrefixSeq(instrCode, delta, jumpSeq);
+        instrBuf.insert(instrBuf.end(), JUMP_SIZE - jumpSeq.size(), pfixCode);
+        instrBuf.insert(instrBuf.end(), jumpSeq.begin(), jumpSeq.end());
     }
 
   private:
     std::ifstream fileIn;
     std::ofstream fileOut;
 
-    std::vector<Instruction> allInstr;
+    // A deque, since allLines points into it while it grows.
+    std::deque<Instruction> allInstr;
     std::map<std::string, Label> allLabels;
+
+    // Set while assembling an object, whose jumps may target other objects.
+    bool allowExternal = false;
     std::vector<Line> allLines;
 
     /// Maps instructions to their respective codes, available at compile time
@@ -92,26 +175,59 @@ class Assembler {
     static constexpr u8 oprCode  = instrMap.at("opr");
     static constexpr u8 jCode    = instrMap.at("j");
     static constexpr u8 cjCode   = instrMap.at("cj");
-    static constexpr u8 noopCode = (oprCode << 4);
+    static constexpr u8 callCode = instrMap.at("call");
 
     // Maps operations to their respective codes, available at compile time
-    // through a linear search. This allows the compiler to optimize.
-    static constexpr auto operMap = Map<std::string_view, u8, 14>{{
-      std::array<std::pair<std::string_view, u8>, 14> {{
-        {"noop"sv, 0x0}, // No-op.
-        {"rev"sv,  0x1}, // Reverse.
-        {"eqz"sv,  0x2}, // Equals zero.
-        {"gt"sv,   0x3}, // Greater than.
-        {"and"sv,  0x4}, // And.
-        {"or"sv,   0x5}, // Or.
-        {"xor"sv,  0x6}, // Xor.
-        {"and"sv,  0x7}, // And.
-        {"sub"sv,  0x8}, // Subtract.
-        {"mul"sv,  0x9}, // Multiply.
-        {"div"sv,  0xA}, // Divide.
-        {"mod"sv,  0xB}, // Modulo.
-        {"shl"sv,  0xC}, // Shift left.
-        {"shr"sv,  0xD}, // Shift right. 
+    // through a linear search. This allows the compiler to optimize. Codes
+    // must match Transputer::doOp.
+    static constexpr auto operMap = Map<std::string_view, u8, 44>{{
+      std::array<std::pair<std::string_view, u8>, 44> {{
+        {"rev"sv,     0x0},  // Reverse.
+        {"eqz"sv,     0x1},  // Equals zero.
+        {"gt"sv,      0x2},  // Greater than.
+        {"and"sv,     0x3},  // And.
+        {"or"sv,      0x4},  // Or.
+        {"xor"sv,     0x5},  // Xor.
+        {"add"sv,     0x6},  // Add.
+        {"sub"sv,     0x7},  // Subtract.
+        {"mul"sv,     0x8},  // Multiply.
+        {"div"sv,     0x9},  // Divide.
+        {"mod"sv,     0xA},  // Modulo.
+        {"shl"sv,     0xB},  // Shift left.
+        {"shr"sv,     0xC},  // Shift right.
+        {"ret"sv,     0x20}, // Return.
+        {"move"sv,    0x4A}, // Block move.
+        {"blkclr"sv,  0xF0}, // Block clear - VM-specific, not a T800 operation.
+        {"crcword"sv, 0x74}, // CRC of a word.
+        {"crcbyte"sv, 0x75}, // CRC of a byte.
+
+        // T800 floating-point unit.
+        {"fpldnldbi"sv,   0x82}, // Load indexed double.
+        {"fpstnldb"sv,    0x84}, // Store double.
+        {"fpldnlsni"sv,   0x86}, // Load indexed single.
+        {"fpadd"sv,       0x87}, // Add.
+        {"fpstnlsn"sv,    0x88}, // Store single.
+        {"fpsub"sv,       0x89}, // Subtract.
+        {"fpldnldb"sv,    0x8A}, // Load double.
+        {"fpmul"sv,       0x8B}, // Multiply.
+        {"fpdiv"sv,       0x8C}, // Divide.
+        {"fpldnlsn"sv,    0x8E}, // Load single.
+        {"fpgt"sv,        0x94}, // Greater than.
+        {"fpeq"sv,        0x95}, // Equals.
+        {"fpi32tor32"sv,  0x96}, // Load integer as single.
+        {"fpi32tor64"sv,  0x98}, // Load integer as double.
+        {"fptesterr"sv,   0x9C}, // Test and clear the error flag.
+        {"fpstnli32"sv,   0x9E}, // Store as integer.
+        {"fpldzerosn"sv,  0x9F}, // Load single zero.
+        {"fpldzerodb"sv,  0xA0}, // Load double zero.
+        {"fpint"sv,       0xA1}, // Round to an integer value.
+        {"fpdup"sv,       0xA3}, // Duplicate.
+        {"fprev"sv,       0xA4}, // Reverse.
+        {"fpldnladddb"sv, 0xA6}, // Load double and add.
+        {"fpldnlmuldb"sv, 0xA8}, // Load double and multiply.
+        {"fpldnladdsn"sv, 0xAA}, // Load single and add.
+        {"fpentry"sv,     0xAB}, // Operation selected by A.
+        {"fpldnlmulsn"sv, 0xAC}, // Load single and multiply.
       }}
     }};
 
@@ -129,6 +245,37 @@ class Assembler {
 
     /// Assemble and output all instructions.
     void assemble();
+
+    /// Splits the input into label-delimited sections of source lines.
+    std::vector<std::pair<std::string, std::vector<std::string>>>
+    splitSections();
+
+    /// Encodes the lines of one section, leaving jumps as relocations.
+    Section encodeSection(
+      const std::string& label,
+      const std::vector<std::string>& lines,
+      const u64 hash);
+
+    /// Reads the sections cached at @cachePath, keyed by label. A missing or
+    /// unreadable cache yields an empty map.
+    static std::map<std::string, Section> loadCache(const char *cachePath);
+
+    /// Writes @sections to @out in ObjectFormat, under @magic.
+    static void writeSections(
+      std::ofstream& out,
+      const u32 magic,
+      const std::vector<Section>& sections);
+
+    /// Reads the next non-empty line with surrounding whitespace removed.
+    /// Returns false at the end of the input.
+    bool nextLine(std::string& line);
+
+    /// Returns true if the (trimmed) @line declares a label.
+    static bool isLabel(const std::string& line);
+
+    /// Splits an instruction line into its description and value parts.
+    static std::pair<std::string, std::string> splitInstr(
+      const std::string& line);
 };
 
 /// Labels hold references to places in the assembly file.
@@ -149,15 +296,15 @@ struct Label {
 /// * Immediate value instructions:
 /// |   These perform some general function with a given 32-bit immediate 
 /// |   value.
-/// |   e.g. stl, pfix, call, ldnlp
+/// |   e.g. stl, pfix, ldnlp
 /// * Operate instructions:
 /// |   These perform a (generally arithmetic) function on the registers, 
 /// |   specified by the 8-bit opCode.
 /// |   e.g. opr noop, opr add, opr shl
 /// * Jumps:
 ///     These contain a pointer to a label, which is transformed into 
-///     an offset at assembly time.
-///     e.g. j, cj
+///     an offset at assembly or link time.
+///     e.g. j, cj, call
 ///
 /// Additionally, we store the estimated size of the assembled instruction
 /// alongside it. This is useful in the case of optimizing jumps.
@@ -207,33 +354,20 @@ class Instruction {
             Assembler::genPrefixSeq(instrCode, opCode, assembledInstr);
         } else {
             const u32 labelOffset = instrVal.labelPtr->offset;
-            const u32 deltaOffset = atOffset - labelOffset;
-            Assembler::genPrefixSeq(instrCode, deltaOffset, assembledInstr);
-            
-            // Assembling jump instructions is tricky as we are encoding the
-            // jump length with pfix / nfix instructions. With interlocking 
-            // jumps, the number of instructions required to encode one jump can
-            // depend in a circular way on the number of instructions required 
-            // to encode other jumps.
-            //
-            // The cleanest compromise is to encode each jump with a fixed 
-            // number of instructions, and pad to this number with no-ops. 
-            // Eight is the simplest choice here, since it allows jumps in the 
-            // range [-2^31, 2^31 - 1].
-            for (size_t i = assembledInstr.size(); i < 8; i++) {
-                assembledInstr.push_back(Assembler::noopCode);
-            }
+            const u32 deltaOffset =
+                labelOffset - (atOffset + Assembler::JUMP_SIZE);
+            Assembler::genJumpSeq(instrCode, deltaOffset, assembledInstr);
         }
 
         return assembledInstr;
     }
 
     /// Computes the size, in bytes, that the instruction will have once fully
-    /// assembled. Provides an upper bound instead for jumps.
-    u8 estimateSize() {
-        if (isJump()) { return 8; }
-        else if (isOperation()) { return 1 + (instrVal.opCode >= 16); }
-        else { return 1 + (32 - __builtin_clz(instrVal.imm)) / 4; }
+    /// assembled. Only jumps depend on their offset, and those always take
+    /// a fixed-size slot.
+    u8 estimateSize() const {
+        if (isJump()) { return Assembler::JUMP_SIZE; }
+        else { return assemble(0).size(); }
     }
 
     /// Returns true if the instruction has an immediate value.
@@ -248,9 +382,11 @@ class Instruction {
     
     /// Returns true if the instruction is a jump.
     bool isJump() const { 
-        return instrCode == Assembler::jCode || instrCode == Assembler::cjCode; 
+        return instrCode == Assembler::jCode || instrCode == Assembler::cjCode ||
+               instrCode == Assembler::callCode;
     }
 
   private:
-    inline static std::unique_ptr<Assembler> assemblerPtr = nullptr;
+    // Not owned - set by the Assembler that is currently running.
+    inline static Assembler *assemblerPtr = nullptr;
 };
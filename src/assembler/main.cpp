@@ -1,11 +1,32 @@
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+
 #include "include/asm.h"
 
+ABSL_FLAG(std::string, cache, "",
+          "Section cache for incremental assembly. When set, only sections "
+          "changed since the last run with the same cache are re-encoded.");
+ABSL_FLAG(bool, object, false,
+          "Write a relocatable object for the linker instead of an image.");
+
 int main(int argc, char** argv) {
-	const char *fileIn  = argv[1];
-	const char *fileOut = argv[2];
+	const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+
+	if (args.size() < 3) {
+		std::cerr << "Usage: " << args[0] << " [--cache=<path> | --object] <in> <out>\n";
+		return 1;
+	}
+
+	Assembler assembler(args[1], args[2]);
 
-	Assembler assembler(fileIn, fileOut);
-	assembler.run();
+	const std::string cachePath = absl::GetFlag(FLAGS_cache);
+	if (absl::GetFlag(FLAGS_object)) {
+		assembler.runObject();
+	} else if (cachePath.empty()) {
+		assembler.run();
+	} else {
+		assembler.runIncremental(cachePath.c_str());
+	}
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,503 @@
+#include "include/codegen.h"
+
+#include <algorithm>
+#include <deque>
+
+#include "auxlib/BException.h"
+
+using namespace ir;
+
+namespace {
+	/// Link 0's output channel, where `out !` sends.
+	constexpr u32 LINK_OUT = 0x80000000;
+
+	bool isConst(const ExprPtr& expr) {
+		return expr->kind == Expr::Kind::Const;
+	}
+
+	bool isCommutative(const BinOp op) {
+		return op == BinOp::Add || op == BinOp::Mul || op == BinOp::BitAnd ||
+			op == BinOp::BitOr || op == BinOp::BitXor || op == BinOp::Eq;
+	}
+}
+
+std::string CodeGen::generate() {
+	std::ostringstream out;
+
+	visibleProcs = program.procs.size();
+	std::string mainCode;
+	std::set<std::string> mainCallees;
+	generateRoutine(*program.main, {}, 0, mainCode, mainCallees);
+
+	// Generate the PROCs the program reaches.
+	std::vector<const ProcDef*> reached;
+	std::deque<std::string> pending(mainCallees.begin(), mainCallees.end());
+	std::map<std::string, std::string> procCode;
+
+	while (!pending.empty()) {
+		const std::string name = pending.front();
+		pending.pop_front();
+		if (procCode.count(name)) continue;
+
+		const ProcDef *def = program.find(name);
+		visibleProcs = def - program.procs.data();
+		if (def->params.size() > 3)
+			throw BException("Cannot compile PROC %s - it has more than 3 "
+				"parameters.", name.c_str());
+
+		// The parameters follow the locals, which are only known once the
+		// body has been generated, so generate it twice.
+		const u32 firstLabel = nextLabel;
+		std::string code;
+		std::set<std::string> callees;
+		const u32 locals = generateRoutine(*def->body, def->params, 0, code, callees);
+		nextLabel = firstLabel;
+		generateRoutine(*def->body, def->params, locals, code, callees);
+
+		frameWords[name] = locals;
+		calls[name] = callees;
+		procCode[name] = code;
+		reached.push_back(def);
+		pending.insert(pending.end(), callees.begin(), callees.end());
+	}
+
+	// Leave room below the main workspace for the deepest chain of calls.
+	u32 below = 0;
+	for (const std::string& callee: mainCallees) below = std::max(below, depth(callee));
+	if (below > 0) out << "ajw " << below << "\n";
+	out << mainCode;
+
+	if (reached.empty()) return out.str();
+
+	const std::string end = label();
+	out << "j " << end << ":\n";
+	for (const ProcDef *def: reached) {
+		const u32 locals = frameWords[def->name];
+		out << procLabel(def->name) << ":\n";
+		if (locals > 0) out << "ajw -" << locals << "\n";
+		out << procCode[def->name];
+		if (locals > 0) out << "ajw " << locals << "\n";
+		out << "opr ret\n";
+	}
+	out << end << ":\n";
+
+	return out.str();
+}
+
+u32 CodeGen::generateRoutine(
+	const Proc& body,
+	const std::vector<Param>& params,
+	const u32 locals,
+	std::string& code,
+	std::set<std::string>& callees) {
+	Routine current;
+	routine = &current;
+
+	// Above the locals: the return address, then A, B and C of the caller.
+	for (size_t i = 0; i < params.size(); ++i) {
+		Binding binding{Binding::Kind::Local, static_cast<u32>(locals + 1 + i)};
+		if (params[i].mode == Param::Mode::Var) binding.kind = Binding::Kind::Ref;
+		if (params[i].mode == Param::Mode::Array) binding.kind = Binding::Kind::RefArray;
+		current.scope.emplace_back(params[i].name, binding);
+	}
+
+	genProc(body);
+
+	code = current.code.str();
+	callees = current.callees;
+	routine = nullptr;
+	return current.highSlot;
+}
+
+u32 CodeGen::depth(const std::string& name) {
+	u32 deepest = 0;
+	for (const std::string& callee: calls[name]) deepest = std::max(deepest, depth(callee));
+	return 4 + frameWords[name] + deepest;
+}
+
+std::string CodeGen::label() {
+	return "L" + std::to_string(nextLabel++);
+}
+
+std::string CodeGen::procLabel(const std::string& name) {
+	std::string label = "P_" + name;
+	std::replace_if(label.begin(), label.end(), [](const char c) { return !isalnum(c); }, '_');
+	return label;
+}
+
+void CodeGen::emit(const std::string& instr) {
+	routine->code << instr << "\n";
+}
+
+void CodeGen::emit(const std::string& instr, const u32 oper) {
+	routine->code << instr << " " << static_cast<int32_t>(oper) << "\n";
+}
+
+void CodeGen::emitLabel(const std::string& name) {
+	routine->code << name << ":\n";
+}
+
+void CodeGen::genStop() {
+	// Memory never reaches the top of the address space, so this read
+	// faults whatever the memory size.
+	emit("ldc", STOP_ADDRESS);
+	emit("ldnl", 0);
+}
+
+u32 CodeGen::alloc(const u32 words) {
+	const u32 slot = routine->nextSlot;
+	routine->nextSlot += words;
+	routine->highSlot = std::max(routine->highSlot, routine->nextSlot);
+	return slot;
+}
+
+const CodeGen::Binding& CodeGen::lookup(const std::string& name) const {
+	for (auto it = routine->scope.rbegin(); it != routine->scope.rend(); ++it) {
+		if (it->first == name) return it->second;
+	}
+	throw BException("Cannot compile - %s is not declared.", name.c_str());
+}
+
+/* ========== Processes ========== */
+
+void CodeGen::genProc(const Proc& proc) {
+	const u32 mark = routine->nextSlot;
+	const size_t scopeSize = routine->scope.size();
+
+	switch (proc.kind) {
+		case Proc::Kind::Skip:
+			break;
+
+		case Proc::Kind::Stop:
+			genStop();
+			break;
+
+		case Proc::Kind::Assign:
+			genAssign(proc.name, proc.index.get(), *proc.value);
+			break;
+
+		case Proc::Kind::Output:
+			genExpr(*proc.value);
+			emit("ldc", LINK_OUT);
+			emit("stnl", 0);
+			break;
+
+		case Proc::Kind::Seq:
+			for (const ProcPtr& component: proc.body) genProc(*component);
+			break;
+
+		case Proc::Kind::SeqFor: {
+			const u32 index = alloc(1);
+			const u32 left = alloc(1);
+			genExpr(*proc.value);
+			emit("stl", index);
+			genExpr(*proc.count);
+			emit("stl", left);
+			routine->scope.emplace_back(proc.name, Binding{Binding::Kind::Local, index});
+
+			const std::string top = label(), exit = label();
+			emitLabel(top);
+			emit("ldl", left);
+			emit("cj " + exit + ":");
+			genProc(*proc.body[0]);
+			emit("ldl", index);
+			emit("adc", 1);
+			emit("stl", index);
+			emit("ldl", left);
+			emit("adc", -1);
+			emit("stl", left);
+			emit("j " + top + ":");
+			emitLabel(exit);
+			break;
+		}
+
+		case Proc::Kind::While: {
+			const std::string top = label(), exit = label();
+			emitLabel(top);
+			genExpr(*proc.value);
+			emit("cj " + exit + ":");
+			genProc(*proc.body[0]);
+			emit("j " + top + ":");
+			emitLabel(exit);
+			break;
+		}
+
+		case Proc::Kind::If: {
+			const std::string end = label();
+			for (size_t i = 0; i < proc.guards.size(); ++i) {
+				const std::string next = label();
+				genExpr(*proc.guards[i]);
+				emit("cj " + next + ":");
+				genProc(*proc.body[i]);
+				emit("j " + end + ":");
+				emitLabel(next);
+			}
+
+			// No guard held.
+			genStop();
+			emitLabel(end);
+			break;
+		}
+
+		case Proc::Kind::Decl: {
+			const u32 slot = alloc(std::max(proc.size, 1u));
+			routine->scope.emplace_back(proc.name, Binding{
+				proc.size > 0 ? Binding::Kind::Array : Binding::Kind::Local, slot});
+			genProc(*proc.body[0]);
+			break;
+		}
+
+		case Proc::Kind::Abbrev: {
+			const Expr& value = *proc.value;
+			Binding binding;
+
+			if (proc.isVal) {
+				genExpr(value);
+				binding = {Binding::Kind::Local, alloc(1)};
+				emit("stl", binding.slot);
+			} else if (value.kind == Expr::Kind::Var) {
+				// Another name for the same word or array.
+				binding = lookup(value.name);
+			} else if (value.kind == Expr::Kind::Index && isConst(value.lhs) &&
+					lookup(value.name).kind == Binding::Kind::Array) {
+				binding = {Binding::Kind::Local, lookup(value.name).slot + value.lhs->value};
+			} else {
+				genAddress(value);
+				binding = {Binding::Kind::Ref, alloc(1)};
+				emit("stl", binding.slot);
+			}
+
+			routine->scope.emplace_back(proc.name, binding);
+			genProc(*proc.body[0]);
+			break;
+		}
+
+		case Proc::Kind::Call:
+			genCall(proc);
+			break;
+	}
+
+	routine->scope.resize(scopeSize);
+	routine->nextSlot = mark;
+}
+
+void CodeGen::genCall(const Proc& proc) {
+	const ProcDef *def = program.find(proc.name);
+	if (!def || static_cast<size_t>(def - program.procs.data()) >= visibleProcs)
+		throw BException("Cannot compile call of %s - no such PROC is defined "
+			"before the call.", proc.name.c_str());
+	if (def->params.size() != proc.args.size())
+		throw BException("Cannot compile call of %s - it takes %lu parameters, "
+			"not %lu.", proc.name.c_str(), def->params.size(), proc.args.size());
+
+	routine->callees.insert(proc.name);
+
+	auto byValue = [&](const size_t i) { return def->params[i].mode == Param::Mode::Val; };
+	auto load = [&](const size_t i) {
+		if (byValue(i)) genExpr(*proc.args[i]);
+		else genAddress(*proc.args[i]);
+	};
+
+	// Arguments that are more than a load are evaluated first, so that the
+	// others can then be pushed straight into C, B and A.
+	std::vector<int> temps(proc.args.size(), -1);
+	for (size_t i = 0; i < proc.args.size(); ++i) {
+		if (byValue(i) ? isLoad(*proc.args[i]) : isAddressLoad(*proc.args[i])) continue;
+		load(i);
+		temps[i] = alloc(1);
+		emit("stl", temps[i]);
+	}
+
+	for (size_t i = proc.args.size(); i-- > 0;) {
+		if (temps[i] >= 0) emit("ldl", temps[i]);
+		else load(i);
+	}
+
+	emit("call " + procLabel(proc.name) + ":");
+}
+
+/* ========== Expressions ========== */
+
+bool CodeGen::isLoad(const Expr& expr) {
+	switch (expr.kind) {
+		case Expr::Kind::Const:
+		case Expr::Kind::Var:
+			return true;
+		case Expr::Kind::Index:
+			return isConst(expr.lhs);
+		case Expr::Kind::Binary:
+			// adc and eqc.
+			return (expr.op == BinOp::Add || expr.op == BinOp::Sub || expr.op == BinOp::Eq) &&
+				isConst(expr.rhs) && isLoad(*expr.lhs);
+	}
+	return false;
+}
+
+bool CodeGen::isAddressLoad(const Expr& expr) {
+	return expr.kind == Expr::Kind::Var ||
+		(expr.kind == Expr::Kind::Index && isConst(expr.lhs));
+}
+
+void CodeGen::genExpr(const Expr& expr) {
+	switch (expr.kind) {
+		case Expr::Kind::Const:
+			emit("ldc", expr.value);
+			return;
+
+		case Expr::Kind::Var: {
+			const Binding& binding = lookup(expr.name);
+			if (binding.kind == Binding::Kind::Local) {
+				emit("ldl", binding.slot);
+			} else if (binding.kind == Binding::Kind::Ref) {
+				emit("ldl", binding.slot);
+				emit("ldnl", 0);
+			} else {
+				throw BException("Cannot compile - array %s used as a value.",
+					expr.name.c_str());
+			}
+			return;
+		}
+
+		case Expr::Kind::Index: {
+			const Binding& binding = lookup(expr.name);
+			if (isConst(expr.lhs) && binding.kind == Binding::Kind::Array) {
+				emit("ldl", binding.slot + expr.lhs->value);
+			} else if (isConst(expr.lhs) && binding.kind == Binding::Kind::RefArray) {
+				emit("ldl", binding.slot);
+				emit("ldnl", expr.lhs->value);
+			} else {
+				genAddress(expr);
+				emit("ldnl", 0);
+			}
+			return;
+		}
+
+		case Expr::Kind::Binary:
+			break;
+	}
+
+	const Expr& lhs = *expr.lhs;
+	const Expr& rhs = *expr.rhs;
+
+	if (isConst(expr.rhs) && (expr.op == BinOp::Add || expr.op == BinOp::Sub)) {
+		genExpr(lhs);
+		emit("adc", expr.op == BinOp::Add ? rhs.value : 0 - rhs.value);
+		return;
+	}
+	if (isConst(expr.rhs) && expr.op == BinOp::Eq) {
+		genExpr(lhs);
+		emit("eqc", rhs.value);
+		return;
+	}
+
+	// Operations take the left operand from A and the right one from B,
+	// except gt, which tests B > A.
+	const bool lhsInA = expr.op != BinOp::Gt;
+	const bool ordered = !isCommutative(expr.op);
+	const u32 mark = routine->nextSlot;
+
+	if (isLoad(rhs)) {
+		genExpr(lhs);
+		genExpr(rhs);
+		if (ordered && lhsInA) emit("opr rev");
+	} else if (isLoad(lhs)) {
+		genExpr(rhs);
+		genExpr(lhs);
+		if (ordered && !lhsInA) emit("opr rev");
+	} else {
+		const u32 temp = alloc(1);
+		genExpr(rhs);
+		emit("stl", temp);
+		genExpr(lhs);
+		emit("ldl", temp);
+		if (ordered && lhsInA) emit("opr rev");
+	}
+	routine->nextSlot = mark;
+
+	switch (expr.op) {
+		case BinOp::Add:    emit("opr add"); break;
+		case BinOp::Sub:    emit("opr sub"); break;
+		case BinOp::Mul:    emit("opr mul"); break;
+		case BinOp::Div:    emit("opr div"); break;
+		case BinOp::Rem:    emit("opr mod"); break;
+		case BinOp::BitAnd: emit("opr and"); break;
+		case BinOp::BitOr:  emit("opr or"); break;
+		case BinOp::BitXor: emit("opr xor"); break;
+		case BinOp::Shl:    emit("opr shl"); break;
+		case BinOp::Shr:    emit("opr shr"); break;
+		case BinOp::Eq:     emit("opr xor"); emit("opr eqz"); break;
+		case BinOp::Gt:     emit("opr gt"); break;
+	}
+}
+
+void CodeGen::genAddress(const Expr& expr) {
+	if (expr.kind != Expr::Kind::Var && expr.kind != Expr::Kind::Index)
+		throw BException("Cannot compile - %s is not a variable.", toString(expr).c_str());
+
+	const Binding& binding = lookup(expr.name);
+	const bool local = binding.kind == Binding::Kind::Local || binding.kind == Binding::Kind::Array;
+
+	if (expr.kind == Expr::Kind::Var) {
+		emit(local ? "ldlp" : "ldl", binding.slot);
+		return;
+	}
+
+	if (isConst(expr.lhs)) {
+		if (local) {
+			emit("ldlp", binding.slot + expr.lhs->value);
+		} else {
+			emit("ldl", binding.slot);
+			emit("ldnlp", expr.lhs->value);
+		}
+		return;
+	}
+
+	genExpr(*expr.lhs);
+	emit("ldc", 4);
+	emit("opr mul");
+	emit(local ? "ldlp" : "ldl", binding.slot);
+	emit("opr add");
+}
+
+void CodeGen::genAssign(const std::string& name, const Expr *index, const Expr& value) {
+	const Binding& binding = lookup(name);
+
+	if (!index) {
+		genExpr(value);
+		if (binding.kind == Binding::Kind::Local) {
+			emit("stl", binding.slot);
+		} else if (binding.kind == Binding::Kind::Ref) {
+			emit("ldl", binding.slot);
+			emit("stnl", 0);
+		} else {
+			throw BException("Cannot compile - array %s assigned as a whole.", name.c_str());
+		}
+		return;
+	}
+
+	if (index->kind == Expr::Kind::Const) {
+		genExpr(value);
+		if (binding.kind == Binding::Kind::Array) {
+			emit("stl", binding.slot + index->value);
+		} else {
+			emit("ldl", binding.slot);
+			emit("stnl", index->value);
+		}
+		return;
+	}
+
+	// stnl stores B at the address in A.
+	genAddress(*elem(name, index->clone()));
+	if (isLoad(value)) {
+		genExpr(value);
+		emit("opr rev");
+	} else {
+		const u32 mark = routine->nextSlot;
+		const u32 temp = alloc(1);
+		emit("stl", temp);
+		genExpr(value);
+		emit("ldl", temp);
+		routine->nextSlot = mark;
+	}
+	emit("stnl", 0);
+}
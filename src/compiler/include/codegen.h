@@ -0,0 +1,118 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "auxlib/Types.h"
+
+#include "ir.h"
+
+/// Lowers a program to assembler source for the VM.
+///
+/// Every routine keeps its variables in workspace words, addressed with
+/// ldl / stl; arrays take consecutive words, so an element with a constant
+/// subscript is a plain local too. Other elements, and variables passed by
+/// reference, go through ldnl / stnl.
+///
+/// The VM's operations leave B and C as they were rather than popping
+/// them, so expressions never keep more than two values on the stack: an
+/// operand that is a single load goes on top of the other, and otherwise
+/// one operand waits in a workspace temporary.
+///
+/// PROCs take up to three parameters, passed in A, B and C and saved by
+/// call in the new frame. A PROC allocates its locals below the frame with
+/// ajw, so the workspace grows down from where the main process puts it;
+/// without recursion, the depth needed is known up front. STOP reads from
+/// STOP_ADDRESS, which faults the program, and the program halts by running
+/// off the end of its image.
+class CodeGen {
+  public:
+	/// Outside any memory the VM can have, above its link addresses.
+	static constexpr u32 STOP_ADDRESS = 0xFFFFFFFC;
+
+	explicit CodeGen(const ir::Program& _program):
+		program(_program) {}
+
+	std::string generate();
+
+  private:
+	/// Where a name lives, relative to the routine's workspace pointer.
+	struct Binding {
+		enum class Kind : u8 {
+			Local,     // The value is in word @slot.
+			Array,     // The elements start at word @slot.
+			Ref,       // Word @slot holds the variable's address.
+			RefArray,  // Word @slot holds the array's address.
+		};
+
+		Kind kind;
+		u32 slot;
+	};
+
+	/// State of the routine being generated.
+	struct Routine {
+		std::vector<std::pair<std::string, Binding>> scope;
+		u32 nextSlot = 0;
+		u32 highSlot = 0;
+		std::set<std::string> callees;
+		std::ostringstream code;
+	};
+
+	const ir::Program& program;
+	Routine *routine = nullptr;
+	size_t visibleProcs = 0;  // PROCs the current routine may call.
+	u32 nextLabel = 0;
+
+	/// Words of locals of each generated PROC, and the PROCs it calls.
+	std::map<std::string, u32> frameWords;
+	std::map<std::string, std::set<std::string>> calls;
+
+	/// Generates @body into @code, with @params bound to the words after a
+	/// frame of @locals words. Returns the words of locals it needs.
+	u32 generateRoutine(
+		const ir::Proc& body,
+		const std::vector<ir::Param>& params,
+		const u32 locals,
+		std::string& code,
+		std::set<std::string>& callees);
+
+	/// Workspace words needed below the workspace pointer of a caller of
+	/// @name, for its frame, its locals and its own callees.
+	u32 depth(const std::string& name);
+
+	std::string label();
+	static std::string procLabel(const std::string& name);
+
+	void emit(const std::string& instr);
+	void emit(const std::string& instr, const u32 oper);
+	void emitLabel(const std::string& name);
+
+	u32 alloc(const u32 words);
+	const Binding& lookup(const std::string& name) const;
+
+	void genProc(const ir::Proc& proc);
+	void genCall(const ir::Proc& proc);
+
+	/// Stops the program with a fault.
+	void genStop();
+
+	/// Leaves the value of @expr in A.
+	void genExpr(const ir::Expr& expr);
+
+	/// Leaves the address of the variable or element @expr in A.
+	void genAddress(const ir::Expr& expr);
+
+	/// Assigns @value to @name, or to its element @index.
+	void genAssign(const std::string& name, const ir::Expr *index, const ir::Expr& value);
+
+	/// Returns true if @expr compiles to a single push, possibly followed
+	/// by operations on A alone. Such an expression can be evaluated on top
+	/// of another value without disturbing it.
+	static bool isLoad(const ir::Expr& expr);
+
+	/// Likewise for the address of @expr.
+	static bool isAddressLoad(const ir::Expr& expr);
+};
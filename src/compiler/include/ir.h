@@ -0,0 +1,168 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "auxlib/Types.h"
+
+/// Mid-level IR for Occam, between the syntax tree and transputer code.
+///
+/// The IR keeps Occam's structure - SEQ, replicated SEQ, WHILE, IF, scoped
+/// declarations and abbreviations, PROC calls - with expressions as trees
+/// of word-sized values. Occam forbids aliasing: within its scope, a
+/// variable is reachable by one name only, and the names an abbreviation
+/// is made from are not assigned while it is in scope. Passes rely on this
+/// to substitute names and values freely - but only for the abbreviations
+/// of the program itself, as those a pass makes up need not follow it.
+///
+/// Arithmetic follows the VM: words are unsigned, and > compares them
+/// unsigned.
+namespace ir {
+	enum class BinOp : u8 {
+		Add, Sub, Mul, Div, Rem,
+		BitAnd, BitOr, BitXor, Shl, Shr,
+		Eq, Gt,
+	};
+
+	struct Expr;
+	typedef std::unique_ptr<Expr> ExprPtr;
+
+	struct Expr {
+		enum class Kind : u8 { Const, Var, Index, Binary };
+
+		Kind kind;
+		u32 value = 0;          // Const.
+		std::string name;       // Var, or the array of an Index.
+		BinOp op = BinOp::Add;  // Binary.
+		ExprPtr lhs;            // Binary, or the subscript of an Index.
+		ExprPtr rhs;            // Binary.
+
+		ExprPtr clone() const;
+		bool operator==(const Expr& other) const;
+	};
+
+	ExprPtr lit(const u32 value);
+	ExprPtr var(const std::string& name);
+	ExprPtr elem(const std::string& array, ExprPtr subscript);
+	ExprPtr bin(const BinOp op, ExprPtr lhs, ExprPtr rhs);
+
+	struct Proc;
+	typedef std::unique_ptr<Proc> ProcPtr;
+
+	struct Proc {
+		enum class Kind : u8 {
+			Skip,
+			Stop,
+			Assign,   // name [index] := value
+			Output,   // out ! value, on link 0
+			Seq,
+			SeqFor,   // SEQ name = value FOR count
+			While,    // WHILE value
+			If,       // IF, with a guard per body; STOP if none holds
+			Decl,     // INT name: or [size]INT name:
+			Abbrev,   // name IS value: or VAL INT name IS value:
+			Call,     // name (args)
+		};
+
+		Kind kind;
+		std::string name;
+		ExprPtr index;
+		ExprPtr value;
+		ExprPtr count;
+		u32 size = 0;                  // Decl: array length, or 0 for a scalar.
+		bool isVal = false;            // Abbrev: VAL, or an alias of a variable.
+		std::vector<ExprPtr> guards;   // If.
+		std::vector<ExprPtr> args;     // Call.
+
+		/// Seq and If: the components, in order. Scoping and looping
+		/// processes: their single body.
+		std::vector<ProcPtr> body;
+
+		ProcPtr clone() const;
+	};
+
+	ProcPtr skip();
+	ProcPtr stop();
+	ProcPtr assign(const std::string& name, ExprPtr value);
+	ProcPtr assignElem(const std::string& array, ExprPtr subscript, ExprPtr value);
+	ProcPtr output(ExprPtr value);
+	ProcPtr seq(std::vector<ProcPtr> components);
+	ProcPtr seqFor(const std::string& name, ExprPtr base, ExprPtr count, ProcPtr body);
+	ProcPtr whileLoop(ExprPtr cond, ProcPtr body);
+	ProcPtr decl(const std::string& name, ProcPtr body);
+	ProcPtr declArray(const std::string& name, const u32 size, ProcPtr body);
+	ProcPtr abbrev(const std::string& name, ExprPtr target, ProcPtr body);
+	ProcPtr valAbbrev(const std::string& name, ExprPtr value, ProcPtr body);
+	ProcPtr call(const std::string& name, std::vector<ExprPtr> args);
+
+	/// Builds a SEQ of @components.
+	template <typename... Procs>
+	ProcPtr seq(ProcPtr first, Procs... rest) {
+		std::vector<ProcPtr> components;
+		components.push_back(std::move(first));
+		(components.push_back(std::move(rest)), ...);
+		return seq(std::move(components));
+	}
+
+	/// Builds an IF from guard, body pairs.
+	template <typename... Rest>
+	ProcPtr ifs(ExprPtr guard, ProcPtr body, Rest... rest) {
+		ProcPtr proc = std::make_unique<Proc>();
+		proc->kind = Proc::Kind::If;
+		proc->guards.push_back(std::move(guard));
+		proc->body.push_back(std::move(body));
+		if constexpr (sizeof...(rest) > 0) {
+			ProcPtr more = ifs(std::move(rest)...);
+			for (size_t i = 0; i < more->guards.size(); ++i) {
+				proc->guards.push_back(std::move(more->guards[i]));
+				proc->body.push_back(std::move(more->body[i]));
+			}
+		}
+		return proc;
+	}
+
+	template <typename... Args>
+	ProcPtr call(const std::string& name, ExprPtr first, Args... rest) {
+		std::vector<ExprPtr> args;
+		args.push_back(std::move(first));
+		(args.push_back(std::move(rest)), ...);
+		return call(name, std::move(args));
+	}
+
+	struct Param {
+		enum class Mode : u8 {
+			Val,    // VAL INT name - passed by value.
+			Var,    // INT name - a variable of the caller.
+			Array,  // []INT name - an array of the caller.
+		};
+
+		std::string name;
+		Mode mode;
+	};
+
+	struct ProcDef {
+		std::string name;
+		std::vector<Param> params;
+		ProcPtr body;
+	};
+
+	/// A program: its PROCs, and the process that runs first. PROCs may call
+	/// those defined before them only, so there is no recursion.
+	struct Program {
+		std::vector<ProcDef> procs;
+		ProcPtr main;
+
+		/// The PROC called @name, or null.
+		const ProcDef* find(const std::string& name) const;
+	};
+
+	/// Number of nodes in @proc, processes and expressions alike - a
+	/// measure of the code it compiles to.
+	u32 size(const Proc& proc);
+	u32 size(const Expr& expr);
+
+	/// Occam-like source for @proc, for debugging and tests.
+	std::string toString(const Proc& proc, const u32 indent = 0);
+	std::string toString(const Expr& expr);
+}
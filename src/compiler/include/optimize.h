@@ -0,0 +1,90 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "auxlib/Types.h"
+
+#include "ir.h"
+
+struct OptimizeOptions {
+	bool inlining = true;
+	bool unrolling = true;
+	bool propagation = true;
+	bool hoisting = true;
+
+	/// PROCs whose bodies have at most this many IR nodes are inlined.
+	u32 inlineSize = 32;
+
+	/// Replicated SEQs of at most @unrollCount iterations are unrolled, if
+	/// the copies come to at most @unrollSize nodes.
+	u32 unrollCount = 16;
+	u32 unrollSize = 512;
+};
+
+struct OptimizeStats {
+	u32 inlined = 0;     // Calls replaced by the PROC body.
+	u32 unrolled = 0;    // Replicated SEQs unrolled.
+	u32 propagated = 0;  // Names replaced by constants or what they abbreviate.
+	u32 hoisted = 0;     // Index computations moved out of loops.
+};
+
+/// Optimizes a program in place, on the IR:
+///
+/// * inlining replaces calls of small PROCs by their bodies, binding the
+///   parameters with abbreviations of the arguments;
+/// * unrolling replaces `SEQ i = b FOR n` with a constant n by n copies of
+///   the body, each under `VAL INT i IS b + k`;
+/// * propagation substitutes constants for variables and abbreviations
+///   wherever they are known, and abbreviations for their names, then
+///   folds the constant expressions, IF guards and WHILE conditions that
+///   result and drops declarations nothing reads any more;
+/// * hoisting moves the parts of array subscripts that do not change in
+///   a loop into a temporary assigned before it.
+///
+/// Inlining exposes the constant arguments and unrolling the constant
+/// subscripts that propagation then folds, so that most element accesses
+/// in short fixed loops compile to plain ldl / stl instead of address
+/// arithmetic and ldnl / stnl. Substitution is sound because Occam forbids
+/// aliasing; a substitution that would capture a name declared in between
+/// is skipped.
+class Optimizer {
+  public:
+	Optimizer(ir::Program& _program, const OptimizeOptions& _options = OptimizeOptions());
+
+	/// Runs the enabled passes in order: inlining, propagation, unrolling,
+	/// propagation again, hoisting.
+	const OptimizeStats& run();
+
+	void inlineCalls();
+	void unrollLoops();
+	void propagate();
+	void hoistIndices();
+
+	const OptimizeStats& getStats() const { return stats; }
+
+  private:
+	/// Constants known for scalar variables at a point of the program.
+	typedef std::map<std::string, u32> Env;
+
+	ir::Program& program;
+	const OptimizeOptions options;
+	OptimizeStats stats;
+	u32 nextName = 0;
+
+	/// A name that no program uses, derived from @base.
+	std::string freshName(const std::string& base);
+
+	void inlineCalls(ir::ProcPtr& proc);
+	void unrollLoops(ir::ProcPtr& proc);
+	void hoistIndices(ir::ProcPtr& proc);
+
+	void propagate(ir::ProcPtr& proc, Env& env);
+
+	/// Substitutes @env in @expr and folds what is constant.
+	void fold(ir::ExprPtr& expr, const Env& env);
+
+	/// Gives every name declared in @proc a fresh name.
+	void renameBound(ir::Proc& proc);
+};
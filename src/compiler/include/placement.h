@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "auxlib/BException.h"
+#include "auxlib/Types.h"
+
+/// The processes of a replicated PAR and the channels between them.
+///
+/// `PAR i = 0 FOR n` yields n processes; @load is an estimate of each one's
+/// work and @traffic of the words a channel carries, e.g. from the loop
+/// counts around its inputs and outputs.
+struct ProcessGraph {
+	struct Channel {
+		u32 from;
+		u32 to;
+		u64 traffic;
+	};
+
+	std::vector<u64> load;
+	std::vector<Channel> channels;
+
+	u32 addProcess(const u64 procLoad) {
+		load.push_back(procLoad);
+		return load.size() - 1;
+	}
+
+	void addChannel(const u32 from, const u32 to, const u64 traffic) {
+		channels.push_back({from, to, traffic});
+	}
+};
+
+/// A network of transputers and the point-to-point links wiring them.
+/// Each transputer has LINKS links; link k of one node is wired to exactly
+/// one link of another.
+struct Topology {
+	static constexpr u32 LINKS = 4;
+	static constexpr u32 UNWIRED = ~0u;
+
+	struct Port {
+		u32 node = UNWIRED;
+		u32 link = UNWIRED;
+	};
+
+	/// wiring[node][link] is the far end of that link.
+	std::vector<std::array<Port, LINKS>> wiring;
+
+	explicit Topology(const u32 nodes):
+		wiring(nodes) {}
+
+	u32 size() const { return wiring.size(); }
+
+	/// Wires link @linkA of @nodeA to link @linkB of @nodeB.
+	void connect(const u32 nodeA, const u32 linkA, const u32 nodeB, const u32 linkB);
+
+	/// A @width by @height mesh. Links 0-3 face north, east, south and west.
+	static Topology mesh(const u32 width, const u32 height);
+};
+
+/// Where each process runs and which links each channel crosses.
+struct Placement {
+	/// One link a channel is carried over.
+	struct Hop {
+		u32 node;
+		u32 link;
+	};
+
+	std::vector<u32> nodeOf;               // Node of each process.
+	std::vector<u64> nodeLoad;             // Summed load of each node.
+	std::vector<std::vector<Hop>> routes;  // Links crossed by each channel.
+
+	/// Sum over channels of traffic times links crossed.
+	u64 cost;
+};
+
+/// Assigns processes to nodes with a graph-partitioning heuristic.
+///
+/// Processes are first placed greedily, in breadth-first order over the
+/// channels starting from the busiest process, each onto the node nearest
+/// its already placed peers. Single-process moves that lower the cost are
+/// then applied until none is left, Fiduccia-Mattheyses style. Throughout,
+/// no node may carry more than @imbalance above the average load, and no
+/// more than one process above the average count.
+///
+/// Channels are routed along shortest paths, so the cost is the total
+/// traffic all links have to carry.
+class Placer {
+  public:
+	Placer(const ProcessGraph& _graph, const Topology& _topology, const double _imbalance = 0.1);
+
+	Placement place();
+
+  private:
+	const ProcessGraph& graph;
+	const Topology& topology;
+
+	u64 maxLoad;
+	u32 maxProcs;
+
+	/// dist[a][b] is the number of links between nodes a and b.
+	std::vector<std::vector<u32>> dist;
+
+	/// Channels touching each process, as indices into graph.channels.
+	std::vector<std::vector<u32>> adjacent;
+
+	/// Cost of @proc's channels if it ran on @node.
+	u64 procCost(const u32 proc, const u32 node, const std::vector<u32>& nodeOf) const;
+
+	/// Links crossed on a shortest path from @from to @to.
+	std::vector<Placement::Hop> route(const u32 from, const u32 to) const;
+};
@@ -0,0 +1,275 @@
+#include "include/ir.h"
+
+#include <sstream>
+
+namespace ir {
+	ExprPtr Expr::clone() const {
+		ExprPtr copy = std::make_unique<Expr>();
+		copy->kind = kind;
+		copy->value = value;
+		copy->name = name;
+		copy->op = op;
+		if (lhs) copy->lhs = lhs->clone();
+		if (rhs) copy->rhs = rhs->clone();
+		return copy;
+	}
+
+	bool Expr::operator==(const Expr& other) const {
+		if (kind != other.kind) return false;
+		switch (kind) {
+			case Kind::Const:
+				return value == other.value;
+			case Kind::Var:
+				return name == other.name;
+			case Kind::Index:
+				return name == other.name && *lhs == *other.lhs;
+			case Kind::Binary:
+				return op == other.op && *lhs == *other.lhs && *rhs == *other.rhs;
+		}
+		return false;
+	}
+
+	ExprPtr lit(const u32 value) {
+		ExprPtr expr = std::make_unique<Expr>();
+		expr->kind = Expr::Kind::Const;
+		expr->value = value;
+		return expr;
+	}
+
+	ExprPtr var(const std::string& name) {
+		ExprPtr expr = std::make_unique<Expr>();
+		expr->kind = Expr::Kind::Var;
+		expr->name = name;
+		return expr;
+	}
+
+	ExprPtr elem(const std::string& array, ExprPtr subscript) {
+		ExprPtr expr = std::make_unique<Expr>();
+		expr->kind = Expr::Kind::Index;
+		expr->name = array;
+		expr->lhs = std::move(subscript);
+		return expr;
+	}
+
+	ExprPtr bin(const BinOp op, ExprPtr lhs, ExprPtr rhs) {
+		ExprPtr expr = std::make_unique<Expr>();
+		expr->kind = Expr::Kind::Binary;
+		expr->op = op;
+		expr->lhs = std::move(lhs);
+		expr->rhs = std::move(rhs);
+		return expr;
+	}
+
+	ProcPtr Proc::clone() const {
+		ProcPtr copy = std::make_unique<Proc>();
+		copy->kind = kind;
+		copy->name = name;
+		if (index) copy->index = index->clone();
+		if (value) copy->value = value->clone();
+		if (count) copy->count = count->clone();
+		copy->size = size;
+		copy->isVal = isVal;
+		for (const ExprPtr& guard: guards) copy->guards.push_back(guard->clone());
+		for (const ExprPtr& arg: args) copy->args.push_back(arg->clone());
+		for (const ProcPtr& proc: body) copy->body.push_back(proc->clone());
+		return copy;
+	}
+
+	namespace {
+		ProcPtr make(const Proc::Kind kind) {
+			ProcPtr proc = std::make_unique<Proc>();
+			proc->kind = kind;
+			return proc;
+		}
+
+		ProcPtr scope(const Proc::Kind kind, const std::string& name, ProcPtr body) {
+			ProcPtr proc = make(kind);
+			proc->name = name;
+			proc->body.push_back(std::move(body));
+			return proc;
+		}
+
+		const char* opName(const BinOp op) {
+			switch (op) {
+				case BinOp::Add:    return "+";
+				case BinOp::Sub:    return "-";
+				case BinOp::Mul:    return "*";
+				case BinOp::Div:    return "/";
+				case BinOp::Rem:    return "\\";
+				case BinOp::BitAnd: return "/\\";
+				case BinOp::BitOr:  return "\\/";
+				case BinOp::BitXor: return "><";
+				case BinOp::Shl:    return "<<";
+				case BinOp::Shr:    return ">>";
+				case BinOp::Eq:     return "=";
+				case BinOp::Gt:     return ">";
+			}
+			return "?";
+		}
+	}
+
+	ProcPtr skip() { return make(Proc::Kind::Skip); }
+	ProcPtr stop() { return make(Proc::Kind::Stop); }
+
+	ProcPtr assign(const std::string& name, ExprPtr value) {
+		ProcPtr proc = make(Proc::Kind::Assign);
+		proc->name = name;
+		proc->value = std::move(value);
+		return proc;
+	}
+
+	ProcPtr assignElem(const std::string& array, ExprPtr subscript, ExprPtr value) {
+		ProcPtr proc = assign(array, std::move(value));
+		proc->index = std::move(subscript);
+		return proc;
+	}
+
+	ProcPtr output(ExprPtr value) {
+		ProcPtr proc = make(Proc::Kind::Output);
+		proc->value = std::move(value);
+		return proc;
+	}
+
+	ProcPtr seq(std::vector<ProcPtr> components) {
+		ProcPtr proc = make(Proc::Kind::Seq);
+		proc->body = std::move(components);
+		return proc;
+	}
+
+	ProcPtr seqFor(const std::string& name, ExprPtr base, ExprPtr count, ProcPtr body) {
+		ProcPtr proc = scope(Proc::Kind::SeqFor, name, std::move(body));
+		proc->value = std::move(base);
+		proc->count = std::move(count);
+		return proc;
+	}
+
+	ProcPtr whileLoop(ExprPtr cond, ProcPtr body) {
+		ProcPtr proc = scope(Proc::Kind::While, "", std::move(body));
+		proc->value = std::move(cond);
+		return proc;
+	}
+
+	ProcPtr decl(const std::string& name, ProcPtr body) {
+		return scope(Proc::Kind::Decl, name, std::move(body));
+	}
+
+	ProcPtr declArray(const std::string& name, const u32 size, ProcPtr body) {
+		ProcPtr proc = scope(Proc::Kind::Decl, name, std::move(body));
+		proc->size = size;
+		return proc;
+	}
+
+	ProcPtr abbrev(const std::string& name, ExprPtr target, ProcPtr body) {
+		ProcPtr proc = scope(Proc::Kind::Abbrev, name, std::move(body));
+		proc->value = std::move(target);
+		return proc;
+	}
+
+	ProcPtr valAbbrev(const std::string& name, ExprPtr value, ProcPtr body) {
+		ProcPtr proc = abbrev(name, std::move(value), std::move(body));
+		proc->isVal = true;
+		return proc;
+	}
+
+	ProcPtr call(const std::string& name, std::vector<ExprPtr> args) {
+		ProcPtr proc = make(Proc::Kind::Call);
+		proc->name = name;
+		proc->args = std::move(args);
+		return proc;
+	}
+
+	const ProcDef* Program::find(const std::string& name) const {
+		for (const ProcDef& def: procs) {
+			if (def.name == name) return &def;
+		}
+		return nullptr;
+	}
+
+	u32 size(const Expr& expr) {
+		return 1 + (expr.lhs ? size(*expr.lhs) : 0) + (expr.rhs ? size(*expr.rhs) : 0);
+	}
+
+	u32 size(const Proc& proc) {
+		u32 total = 1;
+		for (const ExprPtr *expr: {&proc.index, &proc.value, &proc.count}) {
+			if (*expr) total += size(**expr);
+		}
+		for (const ExprPtr& guard: proc.guards) total += size(*guard);
+		for (const ExprPtr& arg: proc.args) total += size(*arg);
+		for (const ProcPtr& component: proc.body) total += size(*component);
+		return total;
+	}
+
+	std::string toString(const Expr& expr) {
+		switch (expr.kind) {
+			case Expr::Kind::Const:
+				return std::to_string(expr.value);
+			case Expr::Kind::Var:
+				return expr.name;
+			case Expr::Kind::Index:
+				return expr.name + "[" + toString(*expr.lhs) + "]";
+			case Expr::Kind::Binary:
+				return "(" + toString(*expr.lhs) + " " + opName(expr.op) + " " +
+					toString(*expr.rhs) + ")";
+		}
+		return "?";
+	}
+
+	std::string toString(const Proc& proc, const u32 indent) {
+		std::ostringstream out;
+		const std::string pad(indent * 2, ' ');
+
+		out << pad;
+		switch (proc.kind) {
+			case Proc::Kind::Skip:
+				out << "SKIP\n";
+				break;
+			case Proc::Kind::Stop:
+				out << "STOP\n";
+				break;
+			case Proc::Kind::Assign:
+				out << proc.name;
+				if (proc.index) out << "[" << toString(*proc.index) << "]";
+				out << " := " << toString(*proc.value) << "\n";
+				break;
+			case Proc::Kind::Output:
+				out << "out ! " << toString(*proc.value) << "\n";
+				break;
+			case Proc::Kind::Seq:
+				out << "SEQ\n";
+				break;
+			case Proc::Kind::SeqFor:
+				out << "SEQ " << proc.name << " = " << toString(*proc.value)
+					<< " FOR " << toString(*proc.count) << "\n";
+				break;
+			case Proc::Kind::While:
+				out << "WHILE " << toString(*proc.value) << "\n";
+				break;
+			case Proc::Kind::If:
+				out << "IF\n";
+				for (size_t i = 0; i < proc.guards.size(); ++i) {
+					out << pad << "  " << toString(*proc.guards[i]) << "\n"
+						<< toString(*proc.body[i], indent + 2);
+				}
+				return out.str();
+			case Proc::Kind::Decl:
+				if (proc.size > 0) out << "[" << proc.size << "]";
+				out << "INT " << proc.name << ":\n";
+				return out.str() + toString(*proc.body[0], indent);
+			case Proc::Kind::Abbrev:
+				out << (proc.isVal ? "VAL INT " : "INT ") << proc.name << " IS "
+					<< toString(*proc.value) << ":\n";
+				return out.str() + toString(*proc.body[0], indent);
+			case Proc::Kind::Call:
+				out << proc.name << " (";
+				for (size_t i = 0; i < proc.args.size(); ++i) {
+					out << (i > 0 ? ", " : "") << toString(*proc.args[i]);
+				}
+				out << ")\n";
+				break;
+		}
+
+		for (const ProcPtr& component: proc.body) out << toString(*component, indent + 1);
+		return out.str();
+	}
+}
@@ -0,0 +1,683 @@
+#include "include/optimize.h"
+
+#include <algorithm>
+#include <optional>
+
+#include "auxlib/BException.h"
+
+using namespace ir;
+
+namespace {
+	bool isBinder(const Proc& proc) {
+		return proc.kind == Proc::Kind::Decl || proc.kind == Proc::Kind::Abbrev ||
+			proc.kind == Proc::Kind::SeqFor;
+	}
+
+	bool isLoop(const Proc& proc) {
+		return proc.kind == Proc::Kind::While || proc.kind == Proc::Kind::SeqFor;
+	}
+
+	bool isConst(const ExprPtr& expr) {
+		return expr->kind == Expr::Kind::Const;
+	}
+
+	/// Calls @f on each expression of @proc itself, not of its components.
+	template <typename F>
+	void forEachExpr(Proc& proc, F f) {
+		for (ExprPtr *expr: {&proc.index, &proc.value, &proc.count}) {
+			if (*expr) f(*expr);
+		}
+		for (ExprPtr& guard: proc.guards) f(guard);
+		for (ExprPtr& arg: proc.args) f(arg);
+	}
+
+	template <typename F>
+	void forEachExpr(const Proc& proc, F f) {
+		forEachExpr(const_cast<Proc&>(proc), [&](ExprPtr& expr) { f(*expr); });
+	}
+
+	/// Names an expression reads: variables, and arrays it indexes.
+	void freeNames(const Expr& expr, std::set<std::string>& names) {
+		if (expr.kind == Expr::Kind::Var || expr.kind == Expr::Kind::Index)
+			names.insert(expr.name);
+		if (expr.lhs) freeNames(*expr.lhs, names);
+		if (expr.rhs) freeNames(*expr.rhs, names);
+	}
+
+	u32 mentions(const Expr& expr, const std::string& name) {
+		u32 count = (expr.kind == Expr::Kind::Var || expr.kind == Expr::Kind::Index) &&
+			expr.name == name;
+		if (expr.lhs) count += mentions(*expr.lhs, name);
+		if (expr.rhs) count += mentions(*expr.rhs, name);
+		return count;
+	}
+
+	/// Occurrences of @name in @proc, other than as an assignment target,
+	/// counting those in loops twice over.
+	u32 uses(const Proc& proc, const std::string& name, const bool inLoop = false) {
+		u32 count = 0;
+		forEachExpr(proc, [&](const Expr& expr) { count += mentions(expr, name); });
+		if (inLoop) count *= 2;
+
+		if (isBinder(proc) && proc.name == name) return count;
+		for (const ProcPtr& component: proc.body) {
+			count += uses(*component, name, inLoop || isLoop(proc));
+		}
+		return count;
+	}
+
+	/// Returns true if substituting an expression reading @free for @name in
+	/// @proc would put one of them under a declaration of the same name.
+	bool captures(const Proc& proc, const std::string& name, const std::set<std::string>& free) {
+		if (isBinder(proc)) {
+			if (proc.name == name) return false;
+			if (free.count(proc.name)) return true;
+		}
+		for (const ProcPtr& component: proc.body) {
+			if (captures(*component, name, free)) return true;
+		}
+		return false;
+	}
+
+	void substitute(ExprPtr& expr, const std::string& name, const Expr& replacement) {
+		if (expr->lhs) substitute(expr->lhs, name, replacement);
+		if (expr->rhs) substitute(expr->rhs, name, replacement);
+
+		if (expr->name != name) return;
+		if (expr->kind == Expr::Kind::Var) {
+			expr = replacement.clone();
+		} else if (expr->kind == Expr::Kind::Index && replacement.kind == Expr::Kind::Var) {
+			expr->name = replacement.name;
+		}
+	}
+
+	/// Replaces @name by @replacement throughout its scope in @proc, as the
+	/// target of assignments too. @replacement must be a variable or an
+	/// element wherever @name is assigned or passed by reference.
+	void substitute(Proc& proc, const std::string& name, const Expr& replacement) {
+		forEachExpr(proc, [&](ExprPtr& expr) { substitute(expr, name, replacement); });
+
+		if (proc.kind == Proc::Kind::Assign && proc.name == name) {
+			if (replacement.kind == Expr::Kind::Var) {
+				proc.name = replacement.name;
+			} else if (replacement.kind == Expr::Kind::Index && !proc.index) {
+				proc.name = replacement.name;
+				proc.index = replacement.lhs->clone();
+			} else {
+				throw BException("Cannot substitute %s - it is assigned.", name.c_str());
+			}
+		}
+
+		if (isBinder(proc) && proc.name == name) return;
+		for (ProcPtr& component: proc.body) substitute(*component, name, replacement);
+	}
+
+	/// Variables and arrays @proc may change: those it assigns, passes by
+	/// reference or abbreviates.
+	void assignedNames(const Proc& proc, const Program& program, std::set<std::string>& names) {
+		switch (proc.kind) {
+			case Proc::Kind::Assign:
+				names.insert(proc.name);
+				break;
+			case Proc::Kind::Abbrev:
+				if (!proc.isVal) names.insert(proc.value->name);
+				break;
+			case Proc::Kind::Call: {
+				const ProcDef *def = program.find(proc.name);
+				for (size_t i = 0; i < proc.args.size(); ++i) {
+					const bool byValue = def && i < def->params.size() &&
+						def->params[i].mode == Param::Mode::Val;
+					if (!byValue && !proc.args[i]->name.empty()) names.insert(proc.args[i]->name);
+				}
+				break;
+			}
+			default:
+				break;
+		}
+		for (const ProcPtr& component: proc.body) assignedNames(*component, program, names);
+	}
+
+	void boundNames(const Proc& proc, std::set<std::string>& names) {
+		if (isBinder(proc)) names.insert(proc.name);
+		for (const ProcPtr& component: proc.body) boundNames(*component, names);
+	}
+
+	/// Replaces the assignments to @name in its scope in @proc by SKIP.
+	void stripAssigns(ProcPtr& proc, const std::string& name) {
+		if (proc->kind == Proc::Kind::Assign && proc->name == name) {
+			proc = skip();
+			return;
+		}
+		if (isBinder(*proc) && proc->name == name) return;
+		for (ProcPtr& component: proc->body) stripAssigns(component, name);
+	}
+
+	/// Returns true if evaluating @expr may be an error: it divides by
+	/// something other than a non-zero constant.
+	bool mayFail(const Expr& expr) {
+		if (expr.kind == Expr::Kind::Binary &&
+			(expr.op == BinOp::Div || expr.op == BinOp::Rem) &&
+			!(isConst(expr.rhs) && expr.rhs->value != 0)) {
+			return true;
+		}
+		return (expr.lhs && mayFail(*expr.lhs)) || (expr.rhs && mayFail(*expr.rhs));
+	}
+
+	/// Returns true if an assignment to @name in its scope in @proc computes
+	/// something that may be an error, and so cannot be dropped.
+	bool assignsFailing(const Proc& proc, const std::string& name) {
+		if (proc.kind == Proc::Kind::Assign && proc.name == name) {
+			return mayFail(*proc.value) || (proc.index && mayFail(*proc.index));
+		}
+		if (isBinder(proc) && proc.name == name) return false;
+		for (const ProcPtr& component: proc.body) {
+			if (assignsFailing(*component, name)) return true;
+		}
+		return false;
+	}
+
+	/// Flattens nested SEQs and drops SKIPs.
+	void tidy(ProcPtr& proc) {
+		if (proc->kind != Proc::Kind::Seq) return;
+
+		std::vector<ProcPtr> flat;
+		for (ProcPtr& component: proc->body) {
+			if (component->kind == Proc::Kind::Seq) {
+				for (ProcPtr& inner: component->body) flat.push_back(std::move(inner));
+			} else if (component->kind != Proc::Kind::Skip) {
+				flat.push_back(std::move(component));
+			}
+		}
+
+		if (flat.empty()) proc = skip();
+		else if (flat.size() == 1) proc = std::move(flat[0]);
+		else proc->body = std::move(flat);
+	}
+
+	/// Evaluates @lhs @op @rhs as the VM does. Returns false for operations
+	/// the VM leaves undefined, which are left to run.
+	bool evaluate(const BinOp op, const u32 lhs, const u32 rhs, u32& result) {
+		switch (op) {
+			case BinOp::Add:    result = lhs + rhs; return true;
+			case BinOp::Sub:    result = lhs - rhs; return true;
+			case BinOp::Mul:    result = lhs * rhs; return true;
+			case BinOp::Div:    result = rhs ? lhs / rhs : 0; return rhs != 0;
+			case BinOp::Rem:    result = rhs ? lhs % rhs : 0; return rhs != 0;
+			case BinOp::BitAnd: result = lhs & rhs; return true;
+			case BinOp::BitOr:  result = lhs | rhs; return true;
+			case BinOp::BitXor: result = lhs ^ rhs; return true;
+			case BinOp::Shl:    result = rhs < 32 ? lhs << rhs : 0; return rhs < 32;
+			case BinOp::Shr:    result = rhs < 32 ? lhs >> rhs : 0; return rhs < 32;
+			case BinOp::Eq:     result = lhs == rhs; return true;
+			case BinOp::Gt:     result = lhs > rhs; return true;
+		}
+		return false;
+	}
+
+	/// Returns true if @op leaves its left operand unchanged when the right
+	/// one is @rhs.
+	bool isRightIdentity(const BinOp op, const u32 rhs) {
+		switch (op) {
+			case BinOp::Add: case BinOp::Sub: case BinOp::BitOr: case BinOp::BitXor:
+			case BinOp::Shl: case BinOp::Shr:
+				return rhs == 0;
+			case BinOp::Mul: case BinOp::Div:
+				return rhs == 1;
+			default:
+				return false;
+		}
+	}
+
+	bool isLeftIdentity(const BinOp op, const u32 lhs) {
+		switch (op) {
+			case BinOp::Add: case BinOp::BitOr: case BinOp::BitXor:
+				return lhs == 0;
+			case BinOp::Mul:
+				return lhs == 1;
+			default:
+				return false;
+		}
+	}
+
+	std::optional<u32> lookup(const std::map<std::string, u32>& env, const std::string& name) {
+		auto it = env.find(name);
+		if (it == env.end()) return std::nullopt;
+		return it->second;
+	}
+
+	void restore(std::map<std::string, u32>& env, const std::string& name, const std::optional<u32> value) {
+		if (value) env[name] = *value;
+		else env.erase(name);
+	}
+}
+
+Optimizer::Optimizer(Program& _program, const OptimizeOptions& _options):
+	program(_program),
+	options(_options) {}
+
+const OptimizeStats& Optimizer::run() {
+	if (options.inlining) inlineCalls();
+	if (options.propagation) propagate();
+	if (options.unrolling) {
+		unrollLoops();
+		if (options.propagation) propagate();
+	}
+	if (options.hoisting) hoistIndices();
+	return stats;
+}
+
+std::string Optimizer::freshName(const std::string& base) {
+	// No Occam name contains a $.
+	return base + "$" + std::to_string(nextName++);
+}
+
+/* ========== Inlining ========== */
+
+void Optimizer::inlineCalls() {
+	// A PROC may only call those before it, so inlining in order also
+	// inlines the calls within inlined bodies.
+	for (ProcDef& def: program.procs) inlineCalls(def.body);
+	inlineCalls(program.main);
+}
+
+void Optimizer::inlineCalls(ProcPtr& proc) {
+	for (ProcPtr& component: proc->body) inlineCalls(component);
+	if (proc->kind != Proc::Kind::Call) return;
+
+	const ProcDef *def = program.find(proc->name);
+	if (!def || size(*def->body) > options.inlineSize) return;
+
+	if (def->params.size() != proc->args.size())
+		throw BException("Cannot inline %s - it takes %lu parameters, not %lu.",
+			def->name.c_str(), def->params.size(), proc->args.size());
+
+	ProcPtr body = def->body->clone();
+	renameBound(*body);
+
+	// Parameters become abbreviations of the arguments. Fresh names keep an
+	// argument from seeing the parameters bound before it.
+	std::vector<std::string> names;
+	for (const Param& param: def->params) {
+		names.push_back(freshName(param.name));
+		substitute(*body, param.name, *var(names.back()));
+	}
+
+	for (size_t i = def->params.size(); i-- > 0;) {
+		if (def->params[i].mode == Param::Mode::Val) {
+			body = valAbbrev(names[i], std::move(proc->args[i]), std::move(body));
+			continue;
+		}
+
+		const Expr::Kind argKind = proc->args[i]->kind;
+		if (argKind != Expr::Kind::Var && argKind != Expr::Kind::Index)
+			throw BException("Cannot inline %s - parameter %s needs a variable.",
+				def->name.c_str(), def->params[i].name.c_str());
+		body = abbrev(names[i], std::move(proc->args[i]), std::move(body));
+	}
+
+	proc = std::move(body);
+	stats.inlined++;
+}
+
+void Optimizer::renameBound(Proc& proc) {
+	if (isBinder(proc)) {
+		const std::string name = freshName(proc.name);
+		substitute(*proc.body[0], proc.name, *var(name));
+		proc.name = name;
+	}
+	for (ProcPtr& component: proc.body) renameBound(*component);
+}
+
+/* ========== Unrolling ========== */
+
+void Optimizer::unrollLoops() {
+	for (ProcDef& def: program.procs) unrollLoops(def.body);
+	unrollLoops(program.main);
+}
+
+void Optimizer::unrollLoops(ProcPtr& proc) {
+	for (ProcPtr& component: proc->body) unrollLoops(component);
+	if (proc->kind != Proc::Kind::SeqFor || !isConst(proc->count)) return;
+
+	const u32 count = proc->count->value;
+	const ProcPtr& body = proc->body[0];
+	if (count > options.unrollCount || count * size(*body) > options.unrollSize) return;
+
+	// With a variable base, the copies count up from its value on entry.
+	// The body may assign the names the base is made of, so the value is
+	// copied into a variable of its own rather than abbreviated.
+	std::string base;
+	if (!isConst(proc->value)) base = freshName(proc->name);
+
+	std::vector<ProcPtr> copies;
+	for (u32 k = 0; k < count; ++k) {
+		ExprPtr index = base.empty() ? lit(proc->value->value + k) : bin(BinOp::Add, var(base), lit(k));
+		copies.push_back(valAbbrev(proc->name, std::move(index), body->clone()));
+	}
+
+	ProcPtr unrolled = seq(std::move(copies));
+	tidy(unrolled);
+	if (!base.empty())
+		unrolled = decl(base, seq(assign(base, std::move(proc->value)), std::move(unrolled)));
+
+	proc = std::move(unrolled);
+	stats.unrolled++;
+}
+
+/* ========== Propagation ========== */
+
+void Optimizer::propagate() {
+	for (ProcDef& def: program.procs) {
+		Env env;
+		propagate(def.body, env);
+	}
+	Env env;
+	propagate(program.main, env);
+}
+
+void Optimizer::fold(ExprPtr& expr, const Env& env) {
+	switch (expr->kind) {
+		case Expr::Kind::Const:
+			return;
+		case Expr::Kind::Var: {
+			auto it = env.find(expr->name);
+			if (it != env.end()) {
+				expr = lit(it->second);
+				stats.propagated++;
+			}
+			return;
+		}
+		case Expr::Kind::Index:
+			fold(expr->lhs, env);
+			return;
+		case Expr::Kind::Binary:
+			break;
+	}
+
+	fold(expr->lhs, env);
+	fold(expr->rhs, env);
+
+	u32 result;
+	if (isConst(expr->lhs) && isConst(expr->rhs)) {
+		if (evaluate(expr->op, expr->lhs->value, expr->rhs->value, result)) expr = lit(result);
+	} else if (isConst(expr->rhs) && isRightIdentity(expr->op, expr->rhs->value)) {
+		expr = std::move(expr->lhs);
+	} else if (isConst(expr->lhs) && isLeftIdentity(expr->op, expr->lhs->value)) {
+		expr = std::move(expr->rhs);
+	}
+}
+
+void Optimizer::propagate(ProcPtr& proc, Env& env) {
+	switch (proc->kind) {
+		case Proc::Kind::Skip:
+		case Proc::Kind::Stop:
+			return;
+
+		case Proc::Kind::Assign:
+			fold(proc->value, env);
+			if (proc->index) {
+				fold(proc->index, env);
+			} else if (isConst(proc->value)) {
+				env[proc->name] = proc->value->value;
+			} else {
+				env.erase(proc->name);
+			}
+			return;
+
+		case Proc::Kind::Output:
+			fold(proc->value, env);
+			return;
+
+		case Proc::Kind::Seq:
+			for (ProcPtr& component: proc->body) propagate(component, env);
+			tidy(proc);
+			return;
+
+		case Proc::Kind::SeqFor: {
+			fold(proc->value, env);
+			fold(proc->count, env);
+			if (isConst(proc->count) && proc->count->value == 0) {
+				proc = skip();
+				return;
+			}
+
+			// Nothing assigned in the loop is known on any iteration.
+			std::set<std::string> assigned;
+			assignedNames(*proc->body[0], program, assigned);
+			for (const std::string& name: assigned) env.erase(name);
+
+			Env inner = env;
+			inner.erase(proc->name);
+			propagate(proc->body[0], inner);
+			return;
+		}
+
+		case Proc::Kind::While: {
+			std::set<std::string> assigned;
+			assignedNames(*proc->body[0], program, assigned);
+			for (const std::string& name: assigned) env.erase(name);
+
+			fold(proc->value, env);
+			if (isConst(proc->value) && proc->value->value == 0) {
+				proc = skip();
+				return;
+			}
+
+			Env inner = env;
+			propagate(proc->body[0], inner);
+			return;
+		}
+
+		case Proc::Kind::If: {
+			// Guards that never hold go, and so does everything after one
+			// that always does.
+			std::vector<ExprPtr> guards;
+			std::vector<ProcPtr> bodies;
+			for (size_t i = 0; i < proc->guards.size(); ++i) {
+				fold(proc->guards[i], env);
+				const bool known = isConst(proc->guards[i]);
+				if (known && proc->guards[i]->value == 0) continue;
+
+				guards.push_back(std::move(proc->guards[i]));
+				bodies.push_back(std::move(proc->body[i]));
+				if (known) break;
+			}
+
+			if (guards.empty()) {
+				proc = stop();
+				return;
+			}
+			if (isConst(guards[0])) {
+				proc = std::move(bodies[0]);
+				propagate(proc, env);
+				return;
+			}
+
+			// Afterwards, only what every branch agrees on is known.
+			Env joined;
+			for (size_t i = 0; i < bodies.size(); ++i) {
+				Env branch = env;
+				propagate(bodies[i], branch);
+				if (i == 0) {
+					joined = std::move(branch);
+					continue;
+				}
+				for (auto it = joined.begin(); it != joined.end();) {
+					const std::optional<u32> value = lookup(branch, it->first);
+					it = value == it->second ? std::next(it) : joined.erase(it);
+				}
+			}
+
+			proc->guards = std::move(guards);
+			proc->body = std::move(bodies);
+			env = std::move(joined);
+			return;
+		}
+
+		case Proc::Kind::Decl: {
+			const std::string name = proc->name;
+			const std::optional<u32> outer = lookup(env, name);
+			env.erase(name);
+			propagate(proc->body[0], env);
+			restore(env, name, outer);
+
+			// A variable nothing reads any more is dead, and so are the
+			// assignments to it - unless one of them may stop the program.
+			if (uses(*proc->body[0], name) == 0 && !assignsFailing(*proc->body[0], name)) {
+				stripAssigns(proc->body[0], name);
+				tidy(proc->body[0]);
+				proc = std::move(proc->body[0]);
+			}
+			return;
+		}
+
+		case Proc::Kind::Abbrev: {
+			const std::string name = proc->name;
+			ProcPtr& body = proc->body[0];
+
+			if (proc->isVal) fold(proc->value, env);
+			else if (proc->value->kind == Expr::Kind::Index) fold(proc->value->lhs, env);
+
+			const Expr& value = *proc->value;
+			const bool cheap = value.kind == Expr::Kind::Var ||
+				(value.kind == Expr::Kind::Index && isConst(value.lhs));
+
+			std::set<std::string> free;
+			freeNames(value, free);
+
+			// A VAL made from names the body assigns has to keep the value
+			// they had on entry.
+			std::set<std::string> assigned;
+			assignedNames(*body, program, assigned);
+			const bool stable = !proc->isVal || std::none_of(free.begin(), free.end(),
+				[&](const std::string& used) { return assigned.count(used) > 0; });
+
+			if (proc->isVal && value.kind == Expr::Kind::Const) {
+				// Every use of the name folds away.
+				const std::optional<u32> outer = lookup(env, name);
+				env[name] = value.value;
+				propagate(body, env);
+				restore(env, name, outer);
+			} else if (stable && (cheap || uses(*body, name) <= 1) && !captures(*body, name, free)) {
+				substitute(*body, name, value);
+				propagate(body, env);
+			} else {
+				// Kept: stores through an alias are not tracked.
+				if (!proc->isVal) env.erase(value.name);
+				const std::optional<u32> outer = lookup(env, name);
+				env.erase(name);
+				propagate(body, env);
+				restore(env, name, outer);
+				if (!proc->isVal) env.erase(value.name);
+				return;
+			}
+
+			proc = std::move(body);
+			stats.propagated++;
+			return;
+		}
+
+		case Proc::Kind::Call: {
+			const ProcDef *def = program.find(proc->name);
+			for (size_t i = 0; i < proc->args.size(); ++i) {
+				ExprPtr& arg = proc->args[i];
+				const bool byValue = def && i < def->params.size() &&
+					def->params[i].mode == Param::Mode::Val;
+
+				if (byValue) {
+					fold(arg, env);
+				} else {
+					if (arg->kind == Expr::Kind::Index) fold(arg->lhs, env);
+					env.erase(arg->name);
+				}
+			}
+			return;
+		}
+	}
+}
+
+/* ========== Hoisting ========== */
+
+void Optimizer::hoistIndices() {
+	for (ProcDef& def: program.procs) hoistIndices(def.body);
+	hoistIndices(program.main);
+}
+
+void Optimizer::hoistIndices(ProcPtr& proc) {
+	for (ProcPtr& component: proc->body) hoistIndices(component);
+	if (!isLoop(*proc)) return;
+
+	// Names that may differ between iterations.
+	std::set<std::string> variant;
+	assignedNames(*proc->body[0], program, variant);
+	boundNames(*proc->body[0], variant);
+	if (proc->kind == Proc::Kind::SeqFor) variant.insert(proc->name);
+
+	// Pure arithmetic on invariant names. Division is left in place, since
+	// hoisting it out of a loop that never runs could introduce a trap.
+	auto invariant = [&](const Expr& expr, auto& self) -> bool {
+		switch (expr.kind) {
+			case Expr::Kind::Const:
+				return true;
+			case Expr::Kind::Var:
+				return !variant.count(expr.name);
+			case Expr::Kind::Index:
+				return false;
+			case Expr::Kind::Binary:
+				return expr.op != BinOp::Div && expr.op != BinOp::Rem &&
+					self(*expr.lhs, self) && self(*expr.rhs, self);
+		}
+		return false;
+	};
+
+	std::vector<std::pair<std::string, ExprPtr>> temps;
+
+	// Replaces the largest invariant computations in @expr by temporaries.
+	auto hoist = [&](ExprPtr& expr, auto& self) -> void {
+		std::set<std::string> free;
+		freeNames(*expr, free);
+
+		if (expr->kind == Expr::Kind::Binary && !free.empty() && invariant(*expr, invariant)) {
+			for (const auto& [name, hoisted]: temps) {
+				if (*hoisted == *expr) {
+					expr = var(name);
+					return;
+				}
+			}
+			temps.emplace_back(freshName("index"), std::move(expr));
+			expr = var(temps.back().first);
+			return;
+		}
+
+		if (expr->lhs) self(expr->lhs, self);
+		if (expr->rhs) self(expr->rhs, self);
+	};
+
+	// Visits the subscripts in @expr.
+	auto inSubscripts = [&](ExprPtr& expr, auto& self) -> void {
+		if (expr->kind == Expr::Kind::Index) hoist(expr->lhs, hoist);
+		if (expr->lhs) self(expr->lhs, self);
+		if (expr->rhs) self(expr->rhs, self);
+	};
+
+	auto visit = [&](Proc& inner, auto& self) -> void {
+		if (inner.kind == Proc::Kind::Assign && inner.index) hoist(inner.index, hoist);
+		forEachExpr(inner, [&](ExprPtr& expr) { inSubscripts(expr, inSubscripts); });
+		for (ProcPtr& component: inner.body) self(*component, self);
+	};
+	visit(*proc->body[0], visit);
+
+	if (temps.empty()) return;
+
+	std::vector<ProcPtr> steps;
+	for (auto& [name, expr]: temps) steps.push_back(assign(name, std::move(expr)));
+	steps.push_back(std::move(proc));
+
+	ProcPtr hoisted = seq(std::move(steps));
+	for (auto it = temps.rbegin(); it != temps.rend(); ++it) {
+		hoisted = decl(it->first, std::move(hoisted));
+	}
+
+	stats.hoisted += temps.size();
+	proc = std::move(hoisted);
+}
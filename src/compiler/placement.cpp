@@ -0,0 +1,263 @@
+#include "include/placement.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+	constexpr u32 NONE = ~0u;
+}
+
+/* ========== Topology ========== */
+
+void Topology::connect(const u32 nodeA, const u32 linkA, const u32 nodeB, const u32 linkB) {
+	if (nodeA >= size() || nodeB >= size() || linkA >= LINKS || linkB >= LINKS) {
+		throw BException("Cannot wire %u:%u to %u:%u - no such node or link.",
+		                 nodeA, linkA, nodeB, linkB);
+	}
+	if (wiring[nodeA][linkA].node != UNWIRED || wiring[nodeB][linkB].node != UNWIRED) {
+		throw BException("Cannot wire %u:%u to %u:%u - link already in use.",
+		                 nodeA, linkA, nodeB, linkB);
+	}
+
+	wiring[nodeA][linkA] = {nodeB, linkB};
+	wiring[nodeB][linkB] = {nodeA, linkA};
+}
+
+Topology Topology::mesh(const u32 width, const u32 height) {
+	Topology topology(width * height);
+
+	for (u32 y = 0; y < height; ++y) {
+		for (u32 x = 0; x < width; ++x) {
+			const u32 node = y * width + x;
+			if (x + 1 < width)  topology.connect(node, 1, node + 1, 3);
+			if (y + 1 < height) topology.connect(node, 2, node + width, 0);
+		}
+	}
+
+	return topology;
+}
+
+/* ========== Placer ========== */
+
+Placer::Placer(const ProcessGraph& _graph, const Topology& _topology, const double _imbalance):
+	graph(_graph),
+	topology(_topology) {
+	const u32 nProcs = graph.load.size();
+	const u32 nNodes = topology.size();
+
+	if (nNodes == 0) {
+		throw BException("Cannot place processes - the network has no nodes.");
+	}
+
+	adjacent.resize(nProcs);
+	for (u32 c = 0; c < graph.channels.size(); ++c) {
+		const ProcessGraph::Channel& channel = graph.channels[c];
+		if (channel.from >= nProcs || channel.to >= nProcs) {
+			throw BException("Cannot place processes - channel %u connects an "
+			                 "unknown process.", c);
+		}
+		adjacent[channel.from].push_back(c);
+		if (channel.to != channel.from) adjacent[channel.to].push_back(c);
+	}
+
+	// Hop counts between all pairs of nodes, by a breadth-first search from
+	// each.
+	dist.assign(nNodes, std::vector<u32>(nNodes, NONE));
+	for (u32 src = 0; src < nNodes; ++src) {
+		std::vector<u32> queue = {src};
+		dist[src][src] = 0;
+
+		for (u32 head = 0; head < queue.size(); ++head) {
+			const u32 node = queue[head];
+			for (const Topology::Port& port: topology.wiring[node]) {
+				if (port.node == Topology::UNWIRED || dist[src][port.node] != NONE) continue;
+				dist[src][port.node] = dist[src][node] + 1;
+				queue.push_back(port.node);
+			}
+		}
+
+		if (queue.size() != nNodes) {
+			throw BException("Cannot place processes - node %u is not connected "
+			                 "to the whole network.", src);
+		}
+	}
+
+	u64 total = 0, heaviest = 0;
+	for (const u64 procLoad: graph.load) {
+		total += procLoad;
+		heaviest = std::max(heaviest, procLoad);
+	}
+
+	const u64 average = (total + nNodes - 1) / nNodes;
+	maxLoad = std::max({static_cast<u64>(total * (1 + _imbalance) / nNodes), average, heaviest});
+	maxProcs = (nProcs + nNodes - 1) / nNodes + 1;
+}
+
+u64 Placer::procCost(const u32 proc, const u32 node, const std::vector<u32>& nodeOf) const {
+	u64 cost = 0;
+
+	for (const u32 c: adjacent[proc]) {
+		const ProcessGraph::Channel& channel = graph.channels[c];
+		const u32 peer = channel.from == proc ? channel.to : channel.from;
+		const u32 peerNode = peer == proc ? node : nodeOf[peer];
+
+		if (peerNode != NONE) cost += channel.traffic * dist[node][peerNode];
+	}
+
+	return cost;
+}
+
+std::vector<Placement::Hop> Placer::route(const u32 from, const u32 to) const {
+	std::vector<Placement::Hop> hops;
+
+	// Each step takes the first link that brings the channel one hop closer.
+	for (u32 node = from; node != to;) {
+		for (u32 link = 0; link < Topology::LINKS; ++link) {
+			const Topology::Port& port = topology.wiring[node][link];
+			if (port.node != Topology::UNWIRED && dist[port.node][to] + 1 == dist[node][to]) {
+				hops.push_back({node, link});
+				node = port.node;
+				break;
+			}
+		}
+	}
+
+	return hops;
+}
+
+Placement Placer::place() {
+	const u32 nProcs = graph.load.size();
+	const u32 nNodes = topology.size();
+
+	Placement placement;
+	std::vector<u32>& nodeOf = placement.nodeOf;
+	std::vector<u64>& nodeLoad = placement.nodeLoad;
+	std::vector<u32> nodeProcs(nNodes, 0);
+
+	nodeOf.assign(nProcs, NONE);
+	nodeLoad.assign(nNodes, 0);
+
+	auto fits = [&](const u32 proc, const u32 node) {
+		return nodeLoad[node] + graph.load[proc] <= maxLoad && nodeProcs[node] < maxProcs;
+	};
+
+	auto assign = [&](const u32 proc, const u32 node) {
+		if (nodeOf[proc] != NONE) {
+			nodeLoad[nodeOf[proc]] -= graph.load[proc];
+			nodeProcs[nodeOf[proc]]--;
+		}
+		nodeOf[proc] = node;
+		nodeLoad[node] += graph.load[proc];
+		nodeProcs[node]++;
+	};
+
+	// Greedy placement in breadth-first order, so that each process has
+	// placed peers to be near. Heavier channels are followed first.
+	std::vector<u32> order;
+	std::vector<bool> queued(nProcs, false);
+	std::vector<u32> byLoad(nProcs);
+	for (u32 p = 0; p < nProcs; ++p) byLoad[p] = p;
+	std::stable_sort(byLoad.begin(), byLoad.end(), [&](const u32 a, const u32 b) {
+		return graph.load[a] > graph.load[b];
+	});
+
+	for (const u32 root: byLoad) {
+		if (queued[root]) continue;
+		queued[root] = true;
+		order.push_back(root);
+
+		for (u32 head = order.size() - 1; head < order.size(); ++head) {
+			std::vector<u32> channels = adjacent[order[head]];
+			std::stable_sort(channels.begin(), channels.end(), [&](const u32 a, const u32 b) {
+				return graph.channels[a].traffic > graph.channels[b].traffic;
+			});
+
+			for (const u32 c: channels) {
+				for (const u32 peer: {graph.channels[c].from, graph.channels[c].to}) {
+					if (queued[peer]) continue;
+					queued[peer] = true;
+					order.push_back(peer);
+				}
+			}
+		}
+	}
+
+	for (const u32 proc: order) {
+		// Cheapest node that fits; on ties the fuller one, which keeps
+		// neighbours together instead of scattering them over empty nodes.
+		u32 best = NONE;
+		u64 bestCost = std::numeric_limits<u64>::max();
+
+		for (u32 node = 0; node < nNodes; ++node) {
+			if (!fits(proc, node)) continue;
+
+			const u64 cost = procCost(proc, node, nodeOf);
+			if (cost < bestCost || (cost == bestCost && nodeLoad[node] > nodeLoad[best])) {
+				best = node;
+				bestCost = cost;
+			}
+		}
+
+		// Uneven loads can leave no node with room; fall back to the
+		// emptiest.
+		if (best == NONE) {
+			best = std::min_element(nodeLoad.begin(), nodeLoad.end()) - nodeLoad.begin();
+		}
+
+		assign(proc, best);
+	}
+
+	// Refinement: move or swap single processes while that lowers the cost.
+	for (bool improved = true; improved;) {
+		improved = false;
+
+		for (u32 proc = 0; proc < nProcs; ++proc) {
+			const u32 from = nodeOf[proc];
+			const u64 current = procCost(proc, from, nodeOf);
+			if (current == 0) continue;
+
+			for (u32 node = 0; node < nNodes; ++node) {
+				if (node == from || !fits(proc, node)) continue;
+
+				if (procCost(proc, node, nodeOf) < current) {
+					assign(proc, node);
+					improved = true;
+					break;
+				}
+			}
+			if (nodeOf[proc] != from) continue;
+
+			// No room to move to - try trading places with a process on a
+			// node it talks to.
+			for (u32 other = 0; other < nProcs && nodeOf[proc] == from; ++other) {
+				const u32 to = nodeOf[other];
+				if (to == from || procCost(proc, to, nodeOf) >= current) continue;
+
+				const u64 before = current + procCost(other, to, nodeOf);
+				const u64 loadFrom = nodeLoad[from] - graph.load[proc] + graph.load[other];
+				const u64 loadTo = nodeLoad[to] - graph.load[other] + graph.load[proc];
+				if (loadFrom > maxLoad || loadTo > maxLoad) continue;
+
+				assign(proc, to);
+				assign(other, from);
+
+				if (procCost(proc, to, nodeOf) + procCost(other, from, nodeOf) < before) {
+					improved = true;
+				} else {
+					assign(other, to);
+					assign(proc, from);
+				}
+			}
+		}
+	}
+
+	placement.cost = 0;
+	placement.routes.reserve(graph.channels.size());
+	for (const ProcessGraph::Channel& channel: graph.channels) {
+		const u32 from = nodeOf[channel.from], to = nodeOf[channel.to];
+		placement.cost += channel.traffic * dist[from][to];
+		placement.routes.push_back(route(from, to));
+	}
+
+	return placement;
+}
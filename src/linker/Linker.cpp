@@ -0,0 +1,326 @@
+#include "include/Linker.h"
+
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "asm.h"
+
+/* ========== Mapped Objects ========== */
+
+MappedObject::MappedObject(const std::string& _path):
+  path(_path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw BException("Cannot link %s - the file cannot be opened.",
+                         path.c_str());
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        throw BException("Cannot link %s - the file is empty or cannot be "
+                         "read.", path.c_str());
+    }
+
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        throw BException("Cannot link %s - mmap failed.", path.c_str());
+    }
+
+    data = static_cast<const u8*>(mapped);
+    size = st.st_size;
+}
+
+MappedObject::MappedObject(MappedObject&& other) noexcept:
+  path(std::move(other.path)),
+  data(other.data),
+  size(other.size),
+  sections(std::move(other.sections)) {
+    other.data = nullptr;
+}
+
+MappedObject::~MappedObject() {
+    if (data) munmap(const_cast<u8*>(data), size);
+}
+
+void MappedObject::parse() {
+    size_t pos = 0;
+
+    auto fail = [&]() {
+        return BException("Cannot link %s - malformed object at byte %lu.",
+                          path.c_str(), pos);
+    };
+
+    auto take = [&](const size_t len) {
+        if (len > size - pos) throw fail();
+        const u8 *at = data + pos;
+        pos += len;
+        return at;
+    };
+
+    // Integers are little-endian on disk; see ObjectFormat.
+    auto takeU32 = [&]() {
+        const u8 *at = take(4);
+        return static_cast<u32>(at[0]) | (static_cast<u32>(at[1]) << 8) |
+               (static_cast<u32>(at[2]) << 16) | (static_cast<u32>(at[3]) << 24);
+    };
+
+    auto takeString = [&]() {
+        const u32 len = takeU32();
+        return std::string_view(reinterpret_cast<const char*>(take(len)), len);
+    };
+
+    if (takeU32() != ObjectFormat::OBJECT_MAGIC ||
+        takeU32() != ObjectFormat::VERSION) {
+        throw BException("Cannot link %s - not an object file of version %u.",
+                         path.c_str(), ObjectFormat::VERSION);
+    }
+
+    const u32 count = takeU32();
+    sections.reserve(count);
+
+    for (u32 i = 0; i < count; ++i) {
+        ObjSection section;
+        section.label = takeString();
+        take(sizeof(u64)); // Source hash - only used by incremental builds.
+        section.fallsThrough = *take(1);
+        section.size = takeU32();
+        section.bytes = take(section.size);
+
+        const u32 relocCount = takeU32();
+        section.relocs.reserve(relocCount);
+        for (u32 r = 0; r < relocCount; ++r) {
+            ObjReloc reloc;
+            reloc.offset = takeU32();
+            reloc.instrCode = *take(1);
+            reloc.label = takeString();
+
+            if (reloc.offset > section.size ||
+                section.size - reloc.offset < Assembler::JUMP_SIZE) {
+                throw fail();
+            }
+            section.relocs.push_back(reloc);
+        }
+
+        sections.push_back(std::move(section));
+    }
+}
+
+/* ========== Symbol Table ========== */
+
+bool Linker::SymbolTable::insert(
+  const std::string_view symbol,
+  const SectionRef ref) {
+    Shard& shard = shards[shardOf(symbol)];
+    std::lock_guard<std::mutex> lock(shard.shardMutex);
+    return shard.symbols.emplace(symbol, ref).second;
+}
+
+const Linker::SectionRef* Linker::SymbolTable::find(
+  const std::string_view symbol) const {
+    const Shard& shard = shards[shardOf(symbol)];
+    auto it = shard.symbols.find(symbol);
+    return it == shard.symbols.end() ? nullptr : &it->second;
+}
+
+/* ========== Linker ========== */
+
+template <typename Fn>
+void Linker::parallelFor(const u32 n, Fn fn) {
+    const u32 nThreads =
+        std::max(1u, std::min(n, std::thread::hardware_concurrency()));
+
+    std::atomic<u32> next{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto worker = [&]() {
+        for (u32 i = next++; i < n; i = next++) {
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (u32 t = 1; t < nThreads; ++t) threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread: threads) thread.join();
+
+    if (error) std::rethrow_exception(error);
+}
+
+std::vector<u8> Linker::link(Stats& stats) {
+    if (inputPaths.empty()) {
+        throw BException("Cannot link - no input objects given.");
+    }
+
+    const u32 nObjects = inputPaths.size();
+    std::vector<MappedObject> objects;
+    objects.reserve(nObjects);
+    for (const std::string& path: inputPaths) objects.emplace_back(path);
+
+    // Parse every object and register its labels, exporting the global ones.
+    SymbolTable symbols;
+    std::vector<LocalSymbols> locals(nObjects);
+    parallelFor(nObjects, [&](const u32 obj) {
+        objects[obj].parse();
+
+        const auto& sections = objects[obj].sections;
+        for (u32 sec = 0; sec < sections.size(); ++sec) {
+            const std::string_view label = sections[sec].label;
+            if (label.empty()) continue;
+
+            if (label == END_SYMBOL ||
+                !locals[obj].emplace(label, SectionRef{obj, sec}).second ||
+                (isExported(label) && !symbols.insert(label, {obj, sec}))) {
+                throw BException("Cannot link - symbol %.*s is defined more "
+                                 "than once.", (int)label.size(), label.data());
+            }
+        }
+    });
+
+    // Resolves a jump target of @obj: its own labels first, then globals.
+    auto resolve = [&](const u32 obj, const std::string_view label) {
+        auto it = locals[obj].find(label);
+        return it != locals[obj].end() ? &it->second : symbols.find(label);
+    };
+
+    if (objects[0].sections.empty()) {
+        throw BException("Cannot link - the entry object %s is empty.",
+                         objects[0].path.c_str());
+    }
+
+    // Mark the sections reachable from the entry point.
+    std::vector<std::vector<bool>> kept(nObjects);
+    for (u32 obj = 0; obj < nObjects; ++obj) {
+        kept[obj].assign(objects[obj].sections.size(), false);
+    }
+
+    std::vector<SectionRef> worklist = {{0, 0}};
+    kept[0][0] = true;
+
+    auto keep = [&](const SectionRef ref) {
+        if (!kept[ref.object][ref.section]) {
+            kept[ref.object][ref.section] = true;
+            worklist.push_back(ref);
+        }
+    };
+
+    while (!worklist.empty()) {
+        const SectionRef ref = worklist.back();
+        worklist.pop_back();
+
+        const ObjSection& section = objects[ref.object].sections[ref.section];
+
+        if (section.fallsThrough &&
+            ref.section + 1 < objects[ref.object].sections.size()) {
+            keep({ref.object, ref.section + 1});
+        }
+
+        for (const ObjReloc& reloc: section.relocs) {
+            if (reloc.label == END_SYMBOL) continue;
+
+            const SectionRef *target = resolve(ref.object, reloc.label);
+            if (!target) {
+                throw BException("Cannot link - symbol %.*s, used in %s, is "
+                                 "not defined.", (int)reloc.label.size(),
+                                 reloc.label.data(),
+                                 objects[ref.object].path.c_str());
+            }
+            keep(*target);
+        }
+    }
+
+    // Lay the kept sections out in input order. Sections that fall through
+    // are therefore still followed by their successor - except at the end of
+    // an object, where only the end of the image may follow.
+    std::vector<std::vector<u32>> offsets(nObjects);
+    u32 imageSize = 0;
+    stats.sections = 0;
+    stats.keptSections = 0;
+    const MappedObject *fallingOff = nullptr;
+
+    for (u32 obj = 0; obj < nObjects; ++obj) {
+        const auto& sections = objects[obj].sections;
+        offsets[obj].assign(sections.size(), 0);
+
+        for (u32 sec = 0; sec < sections.size(); ++sec) {
+            stats.sections++;
+            if (!kept[obj][sec]) continue;
+
+            if (fallingOff) {
+                throw BException("Cannot link - the code at the end of %s "
+                                 "would run on into %s.",
+                                 fallingOff->path.c_str(),
+                                 objects[obj].path.c_str());
+            }
+
+            stats.keptSections++;
+            offsets[obj][sec] = imageSize;
+            imageSize += sections[sec].size;
+
+            if (sec + 1 == sections.size() && sections[sec].fallsThrough)
+                fallingOff = &objects[obj];
+        }
+    }
+    stats.imageSize = imageSize;
+
+    // Copy and relocate in a single pass. Objects own disjoint ranges of the
+    // image, so they can be written concurrently.
+    std::vector<u8> image(imageSize);
+    parallelFor(nObjects, [&](const u32 obj) {
+        const auto& sections = objects[obj].sections;
+
+        for (u32 sec = 0; sec < sections.size(); ++sec) {
+            if (!kept[obj][sec]) continue;
+
+            const ObjSection& section = sections[sec];
+            const u32 sectionOffset = offsets[obj][sec];
+            std::memcpy(image.data() + sectionOffset, section.bytes, section.size);
+
+            std::vector<u8> jumpSeq;
+            for (const ObjReloc& reloc: section.relocs) {
+                u32 targetOffset = imageSize;
+                if (reloc.label != END_SYMBOL) {
+                    const SectionRef *target = resolve(obj, reloc.label);
+                    targetOffset = offsets[target->object][target->section];
+                }
+
+                const u32 slotOffset = sectionOffset + reloc.offset;
+                jumpSeq.clear();
+                Assembler::genJumpSeq(reloc.instrCode,
+                    targetOffset - (slotOffset + Assembler::JUMP_SIZE), jumpSeq);
+                std::memcpy(image.data() + slotOffset, jumpSeq.data(),
+                            jumpSeq.size());
+            }
+        }
+    });
+
+    return image;
+}
+
+Linker::Stats Linker::link(const char *outPath) {
+    Stats stats;
+    const std::vector<u8> image = link(stats);
+
+    std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(image.data()), image.size());
+    if (!out) {
+        throw BException("Cannot write linked image to %s.", outPath);
+    }
+
+    return stats;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "auxlib/BException.h"
+#include "auxlib/Types.h"
+
+/// A jump slot in a mapped section. @label points into the mapped file.
+struct ObjReloc {
+    u32 offset;
+    u8 instrCode;
+    std::string_view label;
+};
+
+/// A section of a mapped object. @bytes and @label point into the mapped
+/// file, so parsing an object copies nothing but the relocation table.
+struct ObjSection {
+    std::string_view label;
+    const u8 *bytes;
+    u32 size;
+    bool fallsThrough;
+    std::vector<ObjReloc> relocs;
+};
+
+/// A relocatable object, as written by Assembler::runObject, mapped into
+/// memory.
+struct MappedObject {
+    std::string path;
+    const u8 *data = nullptr;
+    size_t size = 0;
+    std::vector<ObjSection> sections;
+
+    explicit MappedObject(const std::string& _path);
+    MappedObject(MappedObject&& other) noexcept;
+    MappedObject(const MappedObject&) = delete;
+    ~MappedObject();
+
+    /// Parses the mapped file into @sections.
+    void parse();
+};
+
+/// Links relocatable objects into a single image.
+///
+/// Labels are local to their object, so two objects may both define `loop:`
+/// or the compiler's L0, L1, ... Only labels starting with EXPORT_PREFIX -
+/// the compiler's PROC entry points - are global symbols; defining one in
+/// two objects is an error. A jump resolves to a label of its own object
+/// first, then to a global symbol.
+/// Linking starts from the first section of the first object, which becomes
+/// the entry point at the start of the image. Only sections reachable from
+/// it, through jumps, calls and fall-through into the next section of the
+/// same object, are kept - so unused PROCs in a library cost nothing.
+/// Execution never falls through from one object into another: the last
+/// section of an object must end in a jump or ret, unless nothing is laid
+/// out after it, in which case running off it halts the program.
+///
+/// The linker defines one symbol itself, END_SYMBOL, at the end of the
+/// image. Jumping there halts the program.
+///
+/// Objects are mapped rather than read, and parsed, registered in the symbol
+/// table and relocated on all cores.
+class Linker {
+  public:
+    static constexpr std::string_view END_SYMBOL = "__end:";
+    static constexpr std::string_view EXPORT_PREFIX = "P_";
+
+    struct Stats {
+        u32 sections;      // Sections across all inputs.
+        u32 keptSections;  // Sections reachable from the entry point.
+        u32 imageSize;
+    };
+
+    explicit Linker(const std::vector<std::string>& inputs):
+      inputPaths(inputs) {}
+
+    /// Links the inputs and writes the image to @outPath.
+    Stats link(const char *outPath);
+
+    /// Links the inputs and returns the image.
+    std::vector<u8> link(Stats& stats);
+
+  private:
+    /// Where a symbol is defined: object and section index.
+    struct SectionRef {
+        u32 object;
+        u32 section;
+    };
+
+    /// Hash table from symbol to definition, split into independently
+    /// locked shards so that objects can register symbols concurrently.
+    class SymbolTable {
+      public:
+        /// Returns false if @symbol is already defined.
+        bool insert(const std::string_view symbol, const SectionRef ref);
+
+        /// Looks up @symbol. Must not race with insert.
+        const SectionRef* find(const std::string_view symbol) const;
+
+      private:
+        static constexpr u32 SHARDS = 64;
+
+        struct Shard {
+            std::mutex shardMutex;
+            std::unordered_map<std::string_view, SectionRef> symbols;
+        };
+
+        std::array<Shard, SHARDS> shards;
+
+        static u32 shardOf(const std::string_view symbol) {
+            return std::hash<std::string_view>{}(symbol) % SHARDS;
+        }
+    };
+
+    /// Labels of one object, exported or not.
+    using LocalSymbols = std::unordered_map<std::string_view, SectionRef>;
+
+    std::vector<std::string> inputPaths;
+
+    static bool isExported(const std::string_view label) {
+        return label.starts_with(EXPORT_PREFIX);
+    }
+
+    /// Runs @fn(i) for every i in [0, n) across the hardware threads, and
+    /// rethrows the first exception any of them raised.
+    template <typename Fn>
+    static void parallelFor(const u32 n, Fn fn);
+};
@@ -0,0 +1,26 @@
+#include <iostream>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+
+#include "include/Linker.h"
+
+ABSL_FLAG(std::string, out, "a.out", "Path of the linked image.");
+
+int main(int argc, char** argv) {
+	const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+
+	if (args.size() < 2) {
+		std::cerr << "Usage: " << args[0] << " [--out=<image>] <entry.o> "
+		             "[<lib.o>...]\n";
+		return 1;
+	}
+
+	Linker linker(std::vector<std::string>(args.begin() + 1, args.end()));
+
+	const Linker::Stats stats = linker.link(absl::GetFlag(FLAGS_out).c_str());
+	std::cout << "Kept " << stats.keptSections << " of " << stats.sections
+	          << " sections, " << stats.imageSize << " bytes.\n";
+
+	return 0;
+}
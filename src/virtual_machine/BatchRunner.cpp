@@ -0,0 +1,256 @@
+#include "include/BatchRunner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+    /// A read-only mapping of a program image, shared by all workers.
+    class MappedImage {
+      public:
+        explicit MappedImage(const std::string& path) {
+            const int fd = open(path.c_str(), O_RDONLY);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) != 0) {
+                if (fd >= 0) close(fd);
+                error = "cannot open image " + path;
+                return;
+            }
+
+            size = st.st_size;
+            if (size > 0) {
+                void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped == MAP_FAILED) {
+                    error = "cannot map image " + path;
+                    size = 0;
+                } else {
+                    data = static_cast<const u8*>(mapped);
+                }
+            }
+            close(fd);
+        }
+
+        MappedImage(const MappedImage&) = delete;
+
+        ~MappedImage() {
+            if (data) munmap(const_cast<u8*>(data), size);
+        }
+
+        const u8 *data = nullptr;
+        size_t size = 0;
+        std::string error;
+    };
+
+    /// Link 0 of a running job.
+    struct JobLinks {
+        const std::vector<u32> *input = nullptr;
+        size_t inputPos = 0;
+        std::vector<u32> output = {};
+    };
+
+    std::vector<u32> parseWords(const std::string& list) {
+        std::vector<u32> words;
+        std::stringstream ss(list);
+        std::string word;
+        while (std::getline(ss, word, ',')) {
+            words.push_back(static_cast<u32>(std::stoll(word, nullptr, 0)));
+        }
+        return words;
+    }
+}
+
+std::vector<BatchJob> BatchRunner::parseManifest(const std::string& path) {
+    std::ifstream manifest(path);
+    if (!manifest) {
+        throw BException("Cannot read manifest %s.", path.c_str());
+    }
+
+    const std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    std::vector<BatchJob> jobs;
+    std::string line;
+
+    for (u32 lineNo = 1; std::getline(manifest, line); ++lineNo) {
+        std::stringstream ss(line);
+        std::string image;
+        if (!(ss >> image) || image[0] == '#') continue;
+
+        BatchJob job;
+        const std::filesystem::path imagePath(image);
+        job.image = imagePath.is_absolute() ? image : (dir / imagePath).string();
+
+        std::string option;
+        while (ss >> option) {
+            const size_t eq = option.find('=');
+            const std::string key = option.substr(0, eq);
+            const std::string value = eq == std::string::npos ? "" : option.substr(eq + 1);
+
+            try {
+                if (key == "in") {
+                    job.input = parseWords(value);
+                } else if (key == "out") {
+                    job.expected = parseWords(value);
+                    job.checkOutput = true;
+                } else if (key == "budget") {
+                    job.budget = std::stoull(value, nullptr, 0);
+                } else if (key == "mem") {
+                    // Memory may not reach up to the link addresses.
+                    const unsigned long long memSize = std::stoull(value, nullptr, 0);
+                    if (memSize == 0 || memSize > Transputer::LINK_OUT_BASE)
+                        throw std::out_of_range(key);
+                    job.memSize = memSize;
+                } else {
+                    throw std::invalid_argument(key);
+                }
+            } catch (const std::logic_error&) {
+                throw BException("Cannot parse manifest %s - bad option %s on "
+                                 "line %u.", path.c_str(), option.c_str(), lineNo);
+            }
+        }
+
+        jobs.push_back(std::move(job));
+    }
+
+    return jobs;
+}
+
+BatchReport BatchRunner::run(const std::vector<BatchJob>& jobs, u32 threads) {
+    using Clock = std::chrono::steady_clock;
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max(1u, std::min<u32>(threads, jobs.size()));
+
+    // Map each distinct image once, up front.
+    std::unordered_map<std::string, std::unique_ptr<MappedImage>> images;
+    for (const BatchJob& job: jobs) {
+        if (!images.count(job.image)) {
+            images.emplace(job.image, std::make_unique<MappedImage>(job.image));
+        }
+    }
+
+    BatchReport report;
+    report.results.resize(jobs.size());
+    std::atomic<u32> next{0};
+
+    auto worker = [&]() {
+        std::unique_ptr<Transputer> vm;
+
+        for (u32 idx = next++; idx < jobs.size(); idx = next++) {
+            const BatchJob& job = jobs[idx];
+            const MappedImage& image = *images.at(job.image);
+            BatchResult& result = report.results[idx];
+
+            JobLinks links{&job.input};
+            LinkHandlers handlers;
+            handlers.ctx = &links;
+            handlers.in = [](void *ctx, u32 link, u32& word) {
+                JobLinks& io = *static_cast<JobLinks*>(ctx);
+                if (link != 0 || io.inputPos == io.input->size()) return false;
+                word = (*io.input)[io.inputPos++];
+                return true;
+            };
+            handlers.out = [](void *ctx, u32 link, u32 word) {
+                if (link != 0) return false;
+                static_cast<JobLinks*>(ctx)->output.push_back(word);
+                return true;
+            };
+
+            const Clock::time_point start = Clock::now();
+            result.status = RunStatus::Faulted;
+            result.error = image.error;
+
+            // Anything a job throws, e.g. failing to allocate its memory,
+            // fails that job alone.
+            if (result.error.empty()) {
+                try {
+                    // One instance per worker, rebuilt only when a job needs
+                    // a different memory size.
+                    if (!vm || vm->getMemory().getSize() != job.memSize) {
+                        vm.reset();
+                        vm = std::make_unique<Transputer>(job.memSize);
+                    }
+
+                    vm->loadProgram(image.data, image.size);
+                    vm->setLinkHandlers(handlers);
+                    result.status = vm->run(job.budget);
+                } catch (const std::exception& e) {
+                    result.error = e.what();
+                }
+            }
+
+            result.latencyNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - start).count();
+            result.ticks = result.error.empty() ? vm->getTickCount() : 0;
+            result.output = std::move(links.output);
+
+            if (!result.error.empty()) {
+                // Faulted, or the image could not be loaded.
+            } else if (result.status == RunStatus::Blocked) {
+                result.error = "blocked on a link with no input left";
+            } else if (result.status == RunStatus::BudgetExhausted) {
+                result.error = BException("budget of %llu instructions used up",
+                    static_cast<unsigned long long>(job.budget)).msg;
+            } else if (job.checkOutput && result.output != job.expected) {
+                result.error = "output differs from the expected output";
+            }
+            result.passed = result.error.empty();
+
+            if (vm) vm->setLinkHandlers(LinkHandlers{});
+        }
+    };
+
+    const Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+    for (u32 t = 1; t < threads; ++t) workers.emplace_back(worker);
+    worker();
+    for (std::thread& thread: workers) thread.join();
+    report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    report.passed = 0;
+    report.failed = 0;
+    report.ticks = 0;
+    for (const BatchResult& result: report.results) {
+        (result.passed ? report.passed : report.failed)++;
+        report.ticks += result.ticks;
+    }
+
+    return report;
+}
+
+u64 BatchReport::latencyPercentile(const double p) const {
+    if (results.empty()) return 0;
+
+    std::vector<u64> latencies;
+    latencies.reserve(results.size());
+    for (const BatchResult& result: results) latencies.push_back(result.latencyNs);
+    std::sort(latencies.begin(), latencies.end());
+
+    const size_t rank = static_cast<size_t>(std::ceil(p / 100 * latencies.size()));
+    return latencies[std::clamp<size_t>(rank, 1, latencies.size()) - 1];
+}
+
+void BatchReport::print(std::ostream& out, const std::vector<BatchJob>& jobs) const {
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BatchResult& result = results[i];
+        out << (result.passed ? "PASS " : "FAIL ") << jobs[i].image << "  "
+            << result.ticks << " instructions, " << result.latencyNs / 1000 << " us";
+        if (!result.passed) out << " - " << result.error;
+        out << "\n";
+    }
+
+    out << passed << " passed, " << failed << " failed; " << ticks
+        << " instructions in " << seconds << " s, " << mips() << " MIPS\n"
+        << "latency p50 " << latencyPercentile(50) / 1000 << " us, p90 "
+        << latencyPercentile(90) / 1000 << " us, p99 "
+        << latencyPercentile(99) / 1000 << " us, max "
+        << latencyPercentile(100) / 1000 << " us\n";
+}
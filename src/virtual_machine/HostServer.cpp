@@ -0,0 +1,297 @@
+#include "include/HostServer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    /// Number of argument words following each tag.
+    u32 argCount(const u32 tag) {
+        switch (tag) {
+            case HostServer::SP_OPEN:
+            case HostServer::SP_READ:
+            case HostServer::SP_WRITE:
+            case HostServer::SP_SEEK:
+                return 3;
+            case HostServer::SP_CLOSE:
+            case HostServer::SP_TELL:
+            case HostServer::SP_EXIT:
+                return 1;
+            default:
+                return 0;
+        }
+    }
+
+    /// Moves up to @len bytes between @fd and @buffer, retrying short
+    /// transfers. Returns the bytes moved, or -1 on an error before any.
+    template <typename Op, typename Ptr>
+    ssize_t transfer(Op op, const int fd, Ptr buffer, const size_t len) {
+        size_t done = 0;
+        while (done < len) {
+            const ssize_t n = op(fd, buffer + done, len - done);
+            if (n < 0) return done > 0 ? static_cast<ssize_t>(done) : -1;
+            if (n == 0) break;
+            done += n;
+        }
+        return done;
+    }
+}
+
+/* ========== Server ========== */
+
+HostServer::HostServer(const int consoleIn, const int consoleOut, const int consoleErr):
+  consoleFds{consoleIn, consoleOut, consoleErr},
+  thread(&HostServer::serve, this) {}
+
+HostServer::~HostServer() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueReady.notify_one();
+    thread.join();
+}
+
+void HostServer::submit(Request&& request) {
+    {
+        std::lock_guard<std::mutex> lock(request.client->replyMutex);
+        request.client->inFlight++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(std::move(request));
+    }
+    queueReady.notify_one();
+}
+
+void HostServer::serve() {
+    std::vector<Request> batch;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [&]() { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+            batch.swap(queue);
+        }
+
+        for (Request& request: batch) handle(request);
+        batch.clear();
+    }
+}
+
+void HostServer::handle(Request& request) {
+    ClientState& client = *request.client;
+    std::vector<u32> reply;
+    u32 result = SP_SUCCESS;
+
+    // Streams index the client's descriptors; the console ones are shared.
+    auto fdOf = [&](const u32 stream) {
+        if (stream < 3) return consoleFds[stream];
+        return stream < client.fds.size() ? client.fds[stream] : -1;
+    };
+
+    switch (request.tag) {
+        case SP_OPEN: {
+            int flags;
+            switch (request.args[2]) {
+                case OPEN_READ:   flags = O_RDONLY; break;
+                case OPEN_WRITE:  flags = O_WRONLY | O_CREAT | O_TRUNC; break;
+                case OPEN_APPEND: flags = O_WRONLY | O_CREAT | O_APPEND; break;
+                case OPEN_UPDATE: flags = O_RDWR | O_CREAT; break;
+                default:          flags = -1; break;
+            }
+
+            const int fd = flags < 0 ? -1 : open(request.name.c_str(), flags, 0644);
+            if (fd < 0) {
+                reply = {SP_ERROR, 0};
+                break;
+            }
+
+            // Reuse a closed stream number if there is one.
+            u32 stream = 3;
+            while (stream < client.fds.size() && client.fds[stream] >= 0) stream++;
+            if (stream >= client.fds.size()) client.fds.resize(stream + 1, -1);
+            client.fds[stream] = fd;
+
+            reply = {SP_SUCCESS, stream};
+            break;
+        }
+        case SP_CLOSE: {
+            const u32 stream = request.args[0];
+            if (stream >= 3 && fdOf(stream) >= 0) {
+                close(client.fds[stream]);
+                client.fds[stream] = -1;
+            } else {
+                result = SP_ERROR;
+            }
+            reply = {result};
+            break;
+        }
+        case SP_READ: {
+            const int fd = fdOf(request.args[0]);
+            const ssize_t n = fd < 0 ? -1 : transfer(read, fd, request.buffer, request.args[2]);
+            reply = {n < 0 ? SP_ERROR : SP_SUCCESS, static_cast<u32>(std::max<ssize_t>(n, 0))};
+            break;
+        }
+        case SP_WRITE: {
+            const int fd = fdOf(request.args[0]);
+            const ssize_t n = fd < 0 ? -1 : transfer(write, fd,
+                const_cast<const u8*>(request.buffer), request.args[2]);
+            reply = {n < 0 ? SP_ERROR : SP_SUCCESS, static_cast<u32>(std::max<ssize_t>(n, 0))};
+            break;
+        }
+        case SP_SEEK: {
+            const int fd = fdOf(request.args[0]);
+            const off_t offset = static_cast<int32_t>(request.args[1]);
+            const int whence = request.args[2];
+            const bool ok = fd >= 0 &&
+                (whence == SEEK_SET || whence == SEEK_CUR || whence == SEEK_END) &&
+                lseek(fd, offset, whence) >= 0;
+            reply = {ok ? SP_SUCCESS : SP_ERROR};
+            break;
+        }
+        case SP_TELL: {
+            const int fd = fdOf(request.args[0]);
+            const off_t pos = fd < 0 ? -1 : lseek(fd, 0, SEEK_CUR);
+            reply = {pos < 0 ? SP_ERROR : SP_SUCCESS, static_cast<u32>(std::max<off_t>(pos, 0))};
+            break;
+        }
+        case SP_EXIT: {
+            std::lock_guard<std::mutex> lock(client.replyMutex);
+            client.exitStatus = request.args[0];
+            reply = {SP_SUCCESS};
+            break;
+        }
+        default:
+            reply = {SP_UNIMPLEMENTED};
+            break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(client.replyMutex);
+        client.replies.push_back(std::move(reply));
+        client.inFlight--;
+    }
+    client.replyReady.notify_all();
+}
+
+/* ========== Client ========== */
+
+HostServer::Client::Client(HostServer& _server, Transputer& vm):
+  server(_server),
+  state(std::make_shared<ClientState>()) {
+    state->vm = &vm;
+    state->fds.assign(3, -1);
+}
+
+HostServer::Client::~Client() {
+    std::unique_lock<std::mutex> lock(state->replyMutex);
+    state->replyReady.wait(lock, [&]() { return state->inFlight == 0; });
+
+    // Nothing is in flight, so the server is done with the descriptors.
+    for (u32 stream = 3; stream < state->fds.size(); ++stream) {
+        if (state->fds[stream] >= 0) close(state->fds[stream]);
+    }
+}
+
+LinkHandlers HostServer::Client::handlers() {
+    LinkHandlers handlers;
+    handlers.in = &Client::linkIn;
+    handlers.out = &Client::linkOut;
+    handlers.ctx = this;
+    return handlers;
+}
+
+bool HostServer::Client::replyReady() {
+    std::lock_guard<std::mutex> lock(state->replyMutex);
+    return !state->replies.empty();
+}
+
+void HostServer::Client::waitForReply() {
+    // Returns straight away if nothing is in flight, rather than wait for a
+    // reply that will never come.
+    std::unique_lock<std::mutex> lock(state->replyMutex);
+    state->replyReady.wait(lock, [&]() {
+        return !state->replies.empty() || state->inFlight == 0;
+    });
+}
+
+std::optional<u32> HostServer::Client::exitStatus() {
+    std::lock_guard<std::mutex> lock(state->replyMutex);
+    return state->exitStatus;
+}
+
+void HostServer::Client::reset() {
+    std::unique_lock<std::mutex> lock(state->replyMutex);
+    state->replyReady.wait(lock, [&]() { return state->inFlight == 0; });
+
+    state->replies.clear();
+    state->replyPos = 0;
+    pending.clear();
+}
+
+bool HostServer::Client::linkIn(void *ctx, u32 link, u32& word) {
+    Client& client = *static_cast<Client*>(ctx);
+    ClientState& state = *client.state;
+    if (link != 0) return false;
+
+    std::lock_guard<std::mutex> lock(state.replyMutex);
+    if (state.replies.empty()) return false;
+
+    const std::vector<u32>& reply = state.replies.front();
+    word = reply[state.replyPos++];
+    if (state.replyPos == reply.size()) {
+        state.replies.pop_front();
+        state.replyPos = 0;
+    }
+
+    return true;
+}
+
+bool HostServer::Client::linkOut(void *ctx, u32 link, u32 word) {
+    Client& client = *static_cast<Client*>(ctx);
+    if (link != 0) return false;
+
+    client.pending.push_back(word);
+
+    const u32 tag = client.pending[0];
+    if (client.pending.size() < 1 + argCount(tag)) return true;
+
+    Request request;
+    request.client = client.state;
+    request.tag = tag;
+    std::copy(client.pending.begin() + 1, client.pending.end(), request.args);
+    client.pending.clear();
+
+    // Memory is looked up here, on the program's thread, so that a bad
+    // address faults the program instead of the server.
+    WriteableMemory& memory = client.state->vm->getMemory();
+    switch (tag) {
+        case SP_OPEN: {
+            const u8 *name = memory.blockPtr(request.args[0], request.args[1]);
+            request.name.assign(reinterpret_cast<const char*>(name), request.args[1]);
+            break;
+        }
+        case SP_READ:
+            request.buffer = memory.blockPtr(request.args[1], request.args[2]);
+
+            // The server writes behind the back of the decoded blocks and
+            // of the image's proof, so it may not write into the image.
+            if (request.args[2] > 0 &&
+                request.args[1] + request.args[2] > client.state->vm->getCodeBase())
+                throw BException("Attempted to read into the program image at "
+                                 "position %lu.", request.args[1]);
+
+            // Account for the write now, on the program's thread: the
+            // program may halt or be reset before it takes the reply, and
+            // a reset has to clear what the server reads in.
+            memory.wroteBlock(request.args[1], request.args[2]);
+            break;
+        case SP_WRITE:
+            request.buffer = memory.blockPtr(request.args[1], request.args[2]);
+            break;
+    }
+
+    client.server.submit(std::move(request));
+    return true;
+}
@@ -0,0 +1,165 @@
+#include "include/PerfCounters.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+    struct EventConfig {
+        u32 type;
+        u64 config;
+    };
+
+    constexpr u64 cacheMiss(const u64 cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    // In PerfEvent order.
+    constexpr EventConfig EVENT_CONFIGS[PERF_EVENT_COUNT] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_L1D)},
+        {PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_LL)},
+        {PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_ITLB)},
+    };
+
+    constexpr u64 READ_FORMAT = PERF_FORMAT_GROUP |
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    /// Layout of a group read with READ_FORMAT.
+    struct GroupReading {
+        u64 nr;
+        u64 timeEnabled;
+        u64 timeRunning;
+        u64 values[PERF_EVENT_COUNT];
+    };
+
+    int openEvent(const EventConfig& event, const int groupFd) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = event.type;
+        attr.config = event.config;
+        attr.read_format = READ_FORMAT;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        return syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+    }
+
+    u64 nowNanos() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<u64>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+}
+
+PerfSample& PerfSample::operator+=(const PerfSample& other) {
+    nanos += other.nanos;
+    for (u32 i = 0; i < PERF_EVENT_COUNT; ++i) events[i] += other.events[i];
+    return *this;
+}
+
+void PerfSample::addDelta(const PerfSample& after, const PerfSample& before, const PerfSample& overhead) {
+    auto delta = [](const u64 a, const u64 b, const u64 cost) {
+        return a > b && a - b > cost ? a - b - cost : 0;
+    };
+
+    nanos += delta(after.nanos, before.nanos, overhead.nanos);
+    for (u32 i = 0; i < PERF_EVENT_COUNT; ++i) {
+        events[i] += delta(after.events[i], before.events[i], overhead.events[i]);
+    }
+}
+
+PerfCounters::PerfCounters() {
+    std::fill(fds, fds + PERF_EVENT_COUNT, -1);
+    std::fill(slot, slot + PERF_EVENT_COUNT, -1);
+
+    // A group larger than the PMU opens fine but is never scheduled, so it
+    // reads nothing. Drop events from the end until it runs.
+    for (u32 wanted = PERF_EVENT_COUNT; wanted > 0; --wanted) {
+        for (u32 i = 0; i < wanted; ++i) {
+            fds[i] = openEvent(EVENT_CONFIGS[i], leaderFd);
+            if (fds[i] < 0) continue;
+
+            if (leaderFd < 0) leaderFd = fds[i];
+            slot[i] = opened++;
+        }
+
+        if (leaderFd < 0) break;
+
+        GroupReading reading;
+        if (::read(leaderFd, &reading, sizeof(reading)) > 0 && reading.timeRunning > 0) break;
+
+        for (u32 i = 0; i < wanted; ++i) {
+            if (fds[i] >= 0 && fds[i] != leaderFd) close(fds[i]);
+        }
+        close(leaderFd);
+        leaderFd = -1;
+        opened = 0;
+        std::fill(fds, fds + PERF_EVENT_COUNT, -1);
+        std::fill(slot, slot + PERF_EVENT_COUNT, -1);
+    }
+
+    calibrate();
+}
+
+PerfCounters::~PerfCounters() {
+    for (const int fd: fds) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+void PerfCounters::read(PerfSample& sample) const {
+    sample.nanos = nowNanos();
+    if (leaderFd < 0) return;
+
+    GroupReading reading;
+    if (::read(leaderFd, &reading, sizeof(reading)) <= 0) return;
+
+    // Scale up if the kernel had to multiplex the group with other users of
+    // the PMU.
+    const double scale = reading.timeRunning > 0 && reading.timeRunning < reading.timeEnabled
+        ? static_cast<double>(reading.timeEnabled) / reading.timeRunning : 1.0;
+
+    for (u32 i = 0; i < PERF_EVENT_COUNT; ++i) {
+        if (slot[i] >= 0) sample.events[i] = reading.values[slot[i]] * scale;
+    }
+}
+
+void PerfCounters::calibrate() {
+    // The cheapest of a number of back to back reads is the cost a reading
+    // adds to whatever it encloses.
+    PerfSample before, after;
+    for (u32 i = 0; i < PERF_EVENT_COUNT; ++i) overhead.events[i] = ~0ull;
+    overhead.nanos = ~0ull;
+
+    for (int run = 0; run < 64; ++run) {
+        read(before);
+        read(after);
+
+        overhead.nanos = std::min(overhead.nanos, after.nanos - before.nanos);
+        for (u32 i = 0; i < PERF_EVENT_COUNT; ++i) {
+            const u64 cost = after.events[i] > before.events[i]
+                ? after.events[i] - before.events[i] : 0;
+            overhead.events[i] = std::min(overhead.events[i], cost);
+        }
+    }
+}
+
+const char* PerfCounters::name(const PerfEvent event) {
+    switch (event) {
+        case PerfEvent::Cycles:       return "cycles";
+        case PerfEvent::Instructions: return "instructions";
+        case PerfEvent::BranchMisses: return "branch-misses";
+        case PerfEvent::L1DMisses:    return "L1d-misses";
+        case PerfEvent::LLCMisses:    return "LLC-misses";
+        case PerfEvent::ITLBMisses:   return "iTLB-misses";
+    }
+    return "?";
+}
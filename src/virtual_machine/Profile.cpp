@@ -0,0 +1,140 @@
+#include "include/Profile.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+OpClass Profile::classify(const u8 code, const u32 oper) {
+    switch (code) {
+        case 0x3: case 0x4: case 0x5: case 0xF:
+            return OpClass::Local;
+        case 0x6: case 0x7: case 0x8:
+            return OpClass::Constant;
+        case 0xB: case 0xC: case 0xD:
+            return OpClass::NonLocal;
+        case 0x9: case 0xA:
+            return OpClass::Jump;
+        case 0xE:
+            return OpClass::Call;
+        case 0x2:
+            if (oper <= 0xC) return OpClass::Arithmetic;
+            if (oper == 0x20) return OpClass::Call;
+            if (oper == 0x4A || oper == 0x74 || oper == 0x75 || oper == 0xF0)
+                return OpClass::BlockOp;
+            if (Verifier::isFloatOp(oper)) return OpClass::Float;
+            return OpClass::Other;
+        default:
+            return OpClass::Other;
+    }
+}
+
+const char* Profile::name(const OpClass opClass) {
+    switch (opClass) {
+        case OpClass::Local:      return "local";
+        case OpClass::Constant:   return "constant";
+        case OpClass::NonLocal:   return "non-local";
+        case OpClass::Jump:       return "jump";
+        case OpClass::Call:       return "call/ret";
+        case OpClass::Arithmetic: return "arithmetic";
+        case OpClass::BlockOp:    return "block op";
+        case OpClass::Float:      return "float";
+        case OpClass::Other:      return "other";
+    }
+    return "?";
+}
+
+void Profile::enterBlock(const u32 addr) {
+    block = &blocks[addr];
+    block->execs++;
+    counters.read(last);
+}
+
+void Profile::retire(const DecodedInstr& instr) {
+    const u32 ticks = instr.end - instr.start;
+    ProfileEntry& opClass = classes[static_cast<u32>(classify(instr.code, instr.oper))];
+
+    opClass.execs++;
+    opClass.ticks += ticks;
+    total.execs++;
+    total.ticks += ticks;
+    block->ticks += ticks;
+
+    if (granularity == Granularity::Instruction) {
+        PerfSample now;
+        counters.read(now);
+        opClass.cost.addDelta(now, last, counters.readOverhead());
+        block->cost.addDelta(now, last, counters.readOverhead());
+        total.cost.addDelta(now, last, counters.readOverhead());
+
+        // Read again, so the bookkeeping above is not charged to the next
+        // instruction.
+        counters.read(last);
+    }
+}
+
+void Profile::leaveBlock() {
+    if (granularity == Granularity::Block) {
+        PerfSample now;
+        counters.read(now);
+        block->cost.addDelta(now, last, counters.readOverhead());
+        total.cost.addDelta(now, last, counters.readOverhead());
+    }
+    block = nullptr;
+}
+
+void Profile::print(std::ostream& out, const u32 topBlocks) const {
+    std::vector<PerfEvent> events;
+    for (u32 i = 0; i < PERF_EVENT_COUNT; ++i) {
+        if (counters.has(static_cast<PerfEvent>(i))) events.push_back(static_cast<PerfEvent>(i));
+    }
+
+    if (!counters.hasHardware()) {
+        out << "Hardware counters are unavailable here; showing the clock only.\n";
+    }
+
+    // Costs are per emulated instruction.
+    out << std::left << std::setw(18) << "" << std::right
+        << std::setw(12) << "instrs" << std::setw(8) << "share" << std::setw(10) << "ns";
+    for (const PerfEvent event: events) out << std::setw(15) << PerfCounters::name(event);
+    out << "\n";
+
+    auto row = [&](const std::string& label, const ProfileEntry& entry, const bool withCost) {
+        const double perTick = entry.ticks > 0 ? 1.0 / entry.ticks : 0;
+        const double share = total.ticks > 0 ? 100.0 * entry.ticks / total.ticks : 0;
+
+        out << std::left << std::setw(18) << label << std::right
+            << std::setw(12) << entry.ticks
+            << std::setw(7) << std::fixed << std::setprecision(1) << share << "%"
+            << std::setprecision(2);
+        if (withCost) {
+            out << std::setw(10) << entry.cost.nanos * perTick;
+            for (const PerfEvent event: events) out << std::setw(15) << entry.cost[event] * perTick;
+        }
+        out << std::defaultfloat << "\n";
+    };
+
+    row("total", total, true);
+
+    out << "-- by opcode class\n";
+    for (u32 i = 0; i < OP_CLASS_COUNT; ++i) {
+        if (classes[i].execs == 0) continue;
+        row(name(static_cast<OpClass>(i)), classes[i], granularity == Granularity::Instruction);
+    }
+
+    // The costliest blocks, by time.
+    std::vector<std::pair<u32, const ProfileEntry*>> ranked;
+    for (const auto& [addr, entry]: blocks) ranked.emplace_back(addr, &entry);
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+        return a.second->cost.nanos != b.second->cost.nanos
+            ? a.second->cost.nanos > b.second->cost.nanos : a.first < b.first;
+    });
+    if (ranked.size() > topBlocks) ranked.resize(topBlocks);
+
+    out << "-- by block\n";
+    for (const auto& [addr, entry]: ranked) {
+        std::ostringstream label;
+        label << "block " << addr;
+        row(label.str(), *entry, true);
+    }
+}
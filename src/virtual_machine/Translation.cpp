@@ -0,0 +1,53 @@
+#include "include/Translation.h"
+
+#include <dlfcn.h>
+
+#include "auxlib/BException.h"
+
+Translation::Translation(void *_lib, const XlatImage *_desc):
+  lib(_lib),
+  desc(_desc),
+  table(_desc->imageSize, nullptr) {
+    for (u32 i = 0; i < desc->blockCount; ++i) {
+        const XlatBlock& block = desc->blocks[i];
+        if (block.offset < table.size()) table[block.offset] = block.fn;
+    }
+}
+
+Translation::~Translation() {
+    dlclose(lib);
+}
+
+std::shared_ptr<const Translation> Translation::load(const char *soPath) {
+    void *lib = dlopen(soPath, RTLD_NOW | RTLD_LOCAL);
+    if (!lib) {
+        throw BException("Cannot load translation from %s - %s.", soPath,
+                         dlerror());
+    }
+
+    const auto *desc =
+        static_cast<const XlatImage*>(dlsym(lib, XLAT_IMAGE_SYMBOL));
+    if (!desc || desc->abiVersion != XLAT_ABI_VERSION) {
+        dlclose(lib);
+        throw BException("Cannot load translation from %s - not built by "
+                         "xlat for ABI version %u.", soPath, XLAT_ABI_VERSION);
+    }
+
+    return std::shared_ptr<const Translation>(new Translation(lib, desc));
+}
+
+u64 Translation::imageHash(const u8 *image, const size_t len) {
+    // FNV-1a: a translation only has to be told apart from translations of
+    // other images, not from adversarial ones.
+    u64 hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= image[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool Translation::matches(const std::vector<u8>& image) const {
+    return desc->imageSize == image.size() &&
+           desc->imageHash == imageHash(image.data(), image.size());
+}
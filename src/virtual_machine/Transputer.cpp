@@ -1,7 +1,202 @@
 #include "include/Transputer.h"
 
+#include <bit>
+#include <cmath>
+#include <utility>
+
+template <bool Checked, bool Profiled>
+void Transputer::runLoop(u64& budget) {
+    while (budget > 0 && I != memSize) {
+        // A block may be entered with a prefix chain half done, e.g. after
+        // single-stepping with tick(). Finish the chain byte by byte.
+        if (O != 0) {
+            doInstr<Checked>(memPtr->readByte(I));
+            tickCount++;
+            budget--;
+            continue;
+        }
+
+        const Block& block = blockAt(I);
+        if constexpr (Profiled) profile->enterBlock(I);
+
+        for (const DecodedInstr& instr: block.instrs) {
+            // Prefix bytes count as instructions, as if executed one by one.
+            const u32 ticks = instr.end - instr.start;
+
+            I = instr.end - 1;
+            try {
+                execute<Checked>(instr.code, instr.oper);
+            } catch (const LinkStall&) {
+                // Retry the instruction with its prefixes on resume.
+                I = instr.start;
+                if constexpr (Profiled) profile->leaveBlock();
+                throw;
+            }
+
+            tickCount += ticks;
+            budget -= std::min<u64>(budget, ticks);
+            if constexpr (Profiled) profile->retire(instr);
+
+            // The block may just have overwritten itself.
+            if (memPtr->codeWritten()) [[unlikely]] {
+                dropWrittenBlocks();
+
+                // The proof no longer holds, so the rest has to run on the
+                // checked interpreter.
+                if (!Checked && !verified) {
+                    if constexpr (Profiled) profile->leaveBlock();
+                    return;
+                }
+                break;
+            }
+
+            if (I != instr.end || budget == 0) break;
+        }
+
+        if constexpr (Profiled) profile->leaveBlock();
+    }
+}
+
+const XlatServices Transputer::xlatServices = {
+    // readWord
+    [](XlatContext *ctx, u32 addr) {
+        return static_cast<Transputer*>(ctx->vm)->readWord(addr);
+    },
+    // writeWord
+    [](XlatContext *ctx, u32 addr, u32 word) {
+        Transputer *vm = static_cast<Transputer*>(ctx->vm);
+        vm->writeWord(addr, word);
+        ctx->codeWritten = vm->memPtr->codeWritten();
+    },
+    // operate
+    [](XlatContext *ctx, u32 op) {
+        Transputer *vm = static_cast<Transputer*>(ctx->vm);
+        vm->A = ctx->A;
+        vm->B = ctx->B;
+        vm->C = ctx->C;
+        vm->doOp<false>(op);
+        ctx->A = vm->A;
+        ctx->B = vm->B;
+        ctx->C = vm->C;
+        ctx->codeWritten = vm->memPtr->codeWritten();
+    },
+    // badReturn
+    [](XlatContext *, u32 addr) {
+        throw BException("Attempted to return to position %lu, which does "
+                         "not follow a call from this workspace.", addr);
+    },
+};
+
+void Transputer::runTranslated(u64& budget) {
+    // Translated code stores to the workspace directly, past the dirty page
+    // tracking of the memory. The Verifier bounds where it can store.
+    memPtr->markDirty(0, wsHigh);
+
+    XlatContext ctx{I, W, A, B, C, codeBase, memPtr->blockPtr(0, memSize),
+                    0, 0, &xlatServices, this};
+
+    auto sync = [&]() {
+        I = ctx.I;
+        W = ctx.W;
+        A = ctx.A;
+        B = ctx.B;
+        C = ctx.C;
+    };
+
+    // A prefix chain left half done by tick() is finished by the
+    // interpreter.
+    while (budget > 0 && ctx.I != memSize && verified && O == 0) {
+        const XlatBlockFn block = translation->blockAt(ctx.I - codeBase);
+        if (!block) break;
+
+        const u32 start = ctx.I;
+        try {
+            block(&ctx);
+        } catch (...) {
+            // The block spilled its registers ahead of the instruction that
+            // threw, and blocks run straight-line up to it.
+            tickCount += ctx.I - start;
+            sync();
+            throw;
+        }
+
+        tickCount += ctx.ticks;
+        budget -= std::min(budget, ctx.ticks);
+        ctx.ticks = 0;
+
+        // The program stored into its image, so the translation no longer
+        // describes it.
+        if (memPtr->codeWritten()) [[unlikely]] {
+            ctx.codeWritten = 0;
+            dropWrittenBlocks();
+        }
+    }
+
+    sync();
+}
+
+Transputer::Block& Transputer::blockAt(const u32 addr) {
+    auto it = blocks.find(addr);
+    if (it != blocks.end()) return it->second;
+
+    Block block;
+    u32 pc = addr;
+    u32 oper = 0;
+    u32 start = addr;
+
+    // Decoding mirrors the prefix handling of doInstr.
+    while (pc != memSize) {
+        const u8 byte = memPtr->readByte(pc++);
+        const u8 code = byte >> 4;
+        oper |= byte & 0xF;
+
+        if (code == 0x0) {
+            oper <<= 4;
+            continue;
+        } else if (code == 0x1) {
+            oper = (~oper) << 4;
+            continue;
+        }
+
+        block.instrs.push_back({start, pc, code, oper});
+        oper = 0;
+        start = pc;
+
+        const bool endsBlock = code == 0x9 || code == 0xA || code == 0xE ||
+            (code == 0x2 && block.instrs.back().oper == 0x20);
+        if (endsBlock || block.instrs.size() == MAX_BLOCK_INSTRS) break;
+    }
+
+    // A prefix chain running into the end of memory would never complete.
+    if (block.instrs.empty())
+        throw BException("Attempted to execute truncated instruction at "
+                         "position %lu.", addr);
+
+    const u32 end = block.instrs.back().end;
+    memPtr->markCode(addr, end - addr);
+    for (u32 page = addr >> WriteableMemory::PAGE_SHIFT;
+         page <= (end - 1) >> WriteableMemory::PAGE_SHIFT; ++page) {
+        pageBlocks[page].push_back(addr);
+    }
+
+    return blocks.emplace(addr, std::move(block)).first->second;
+}
+
+void Transputer::dropWrittenBlocks() {
+    for (const u32 page: memPtr->takeWrittenCode()) {
+        auto it = pageBlocks.find(page);
+        if (it == pageBlocks.end()) continue;
+
+        for (const u32 addr: it->second) blocks.erase(addr);
+        pageBlocks.erase(it);
+    }
+
+    verified = false;
+}
+
+template <bool Checked>
 void Transputer::doInstr(const u8 instrCode) {
-    const u8  code = instrCode & 0xF0;
+    const u8  code = instrCode >> 4;
     const u32 oper = O | (instrCode & 0xF);
 
     switch (code) {
@@ -14,22 +209,34 @@ void Transputer::doInstr(const u8 instrCode) {
             O = (~oper) << 4;
             advanceInstr();
             break;
+        default:
+            execute<Checked>(code, oper);
+            break;
+    }
+}
+
+template <bool Checked>
+void Transputer::execute(const u8 code, const u32 oper) {
+    switch (code) {
         case 0x2: // opr
             O = 0;
             advanceInstr();
-            doOp(oper);
+            doOp<Checked>(oper);
             break;
 
         /* ===== Memory Local ===== */
-        case 0x3: // ldl
+        case 0x3: { // ldl
+            // Read before touching the stack - the load may stall on a link.
+            const u32 word = readLocal<Checked>(W + oper * 4);
             C = B;
             B = A;
             O = 0;
-            A = readWord(W + oper);
+            A = word;
             advanceInstr();
             break;
+        }
         case 0x4: // stl
-            writeWord(W + oper, A);
+            writeLocal<Checked>(W + oper * 4, A);
             A = B;
             B = C;
             O = 0;
@@ -79,45 +286,51 @@ void Transputer::doInstr(const u8 instrCode) {
             break;
 
         /* ===== Memory Non Local ===== */
+        // These addresses come from the stack, so they are checked even for
+        // verified images - readWord / writeWord reject misaligned and out of
+        // bounds words.
         case 0xB: // ldnl
-            if ((A & 4) != 0) {
-                // Throw error here.
-            } else {
-                A = readWord(A + oper * 4);
-                O = 0;
-                advanceInstr();
-            }
+            A = readWord(A + oper * 4);
+            O = 0;
+            advanceInstr();
             break;
         case 0xC: // stnl
-            if ((A & 4) != 0) {
-                // Throw error here.
-            } else {
-                writeWord(A + oper * 4, B);
-                O = 0;
-                A = C;
-                advanceInstr();
-            }
+            writeWord(A + oper * 4, B);
+            O = 0;
+            A = C;
+            advanceInstr();
             break;
         case 0xD: // ldnlp
-            if ((A & 4) != 0) {
-                // Throw error here.
-            } else {
-                A = A + oper * 4;
-                O = 0;
-                advanceInstr();
-            }
+            A = A + oper * 4;
+            O = 0;
+            advanceInstr();
             break;
 
         /* ===== Other ===== */
-        case 0xE: // call
+        case 0xE: { // call
+            // Save the return address and the stack below the workspace,
+            // then jump. A holds the return address afterwards.
+            const u32 retAddr = I + 1;
+            const u32 frame = W - 16;
+            writeLocal<Checked>(frame, retAddr);
+            writeLocal<Checked>(frame + 4, A);
+            writeLocal<Checked>(frame + 8, B);
+            writeLocal<Checked>(frame + 12, C);
+            W = frame;
+            A = retAddr;
+            O = 0;
+            I = retAddr + oper;
             break;
+        }
         case 0xF: // ajw
             O = 0;
             W += 4 * oper;
+            advanceInstr();
             break;
     }
 }
 
+template <bool Checked>
 void Transputer::doOp(const u8 opCode) {
     switch (opCode) {
         case 0x0:
@@ -160,10 +373,12 @@ void Transputer::doOp(const u8 opCode) {
             break;
         case 0x9:
             /* div */
+            if (B == 0) throw BException("Attempted to divide by zero.");
             A = A / B;
             break;
         case 0xA:
             /* mod */
+            if (B == 0) throw BException("Attempted to divide by zero.");
             A = A % B;
             break;
         case 0xB:
@@ -174,5 +389,347 @@ void Transputer::doOp(const u8 opCode) {
             /* shr - shift right */
             A >>= B;
             break;
+
+        /* ===== Control ===== */
+        case 0x20: {
+            /* ret - return from call */
+            const u32 retAddr = readLocal<Checked>(W);
+            // The return address sits in memory the program may overwrite,
+            // so it is checked even when the image was verified - both that
+            // it follows a call, and that it is the call made from this
+            // workspace. The checked interpreter validates it when fetching
+            // from it instead.
+            const u32 offset = retAddr - codeBase;
+            if (!Checked && (offset >= retTargets.size() ||
+                             retTargets[offset] != W + 16))
+                throw BException("Attempted to return to position %lu, which "
+                                 "does not follow a call from this workspace.",
+                                 retAddr);
+            I = retAddr;
+            W += 16;
+            break;
+        }
+
+        /* ===== Block Operations ===== */
+        case 0x4A:
+            /* move - copy A bytes from C to B */
+            memPtr->moveBlock(B, C, A);
+            break;
+        case 0xF0:
+            /* blkclr - zero A bytes starting at B. Not a T800 operation; its
+               code lies above all of the T800's. */
+            memPtr->clearBlock(B, A);
+            break;
+        case 0x74:
+            /* crcword - CRC of the word in A, accumulated into B, generator C */
+            A = crcStep(B, A, C, 4);
+            B = C;
+            break;
+        case 0x75:
+            /* crcbyte - CRC of the top byte of A, accumulated into B, generator C */
+            A = crcStep(B, A, C, 1);
+            B = C;
+            break;
+
+        /* ===== Floating Point ===== */
+        case 0x82: case 0x84: case 0x86: case 0x87: case 0x88: case 0x89:
+        case 0x8A: case 0x8B: case 0x8C: case 0x8E:
+        case 0x94: case 0x95: case 0x96: case 0x98: case 0x9C: case 0x9E:
+        case 0x9F: case 0xA0: case 0xA1: case 0xA3: case 0xA4: case 0xA6:
+        case 0xA8: case 0xAA: case 0xAB: case 0xAC:
+            doFpOp(opCode);
+            break;
+    }
+}
+
+template <typename T, typename F>
+auto Transputer::fpRounded(const int round, const T a, const T b, F compute) {
+    typedef decltype(compute(a, b)) R;
+    if (round == FE_TONEAREST) [[likely]] return compute(a, b);
+
+    // Volatile operands and result pin the computation between the mode
+    // switches, which the compiler would otherwise move it across.
+    volatile T x = a, y = b;
+    fesetround(round);
+    volatile R result = compute(x, y);
+    fesetround(FE_TONEAREST);
+    return static_cast<R>(result);
+}
+
+void Transputer::doFpOp(const u8 opCode) {
+    // A rounding mode lasts for one operation.
+    const int round = std::exchange(fpRound, FE_TONEAREST);
+
+    auto loadSingle = [&](const u32 addr) {
+        return FpReg{std::bit_cast<float>(readWord(addr)), true};
+    };
+    auto loadDouble = [&](const u32 addr) {
+        const u64 bits = readWord(addr) | (static_cast<u64>(readWord(addr + 4)) << 32);
+        return FpReg{std::bit_cast<double>(bits), false};
+    };
+
+    // FA := FB op FA, in single precision if both are single.
+    auto binary = [&](auto op) {
+        FpReg result{0, FA.single && FB.single};
+        if (result.single) {
+            result.value = fpRounded(round, static_cast<float>(FB.value),
+                                     static_cast<float>(FA.value), op);
+        } else {
+            result.value = fpRounded(round, FB.value, FA.value, op);
+        }
+        fpError |= !std::isfinite(result.value);
+        fpPop();
+        FA = result;
+    };
+
+    // FA := op FA, in its own precision.
+    auto unary = [&](auto op) {
+        if (FA.single) {
+            const float value = FA.value;
+            FA.value = fpRounded(round, value, value, [&](float x, float) { return op(x); });
+        } else {
+            FA.value = fpRounded(round, FA.value, FA.value, [&](double x, double) { return op(x); });
+        }
+        fpError |= !std::isfinite(FA.value);
+    };
+
+    auto add = [](auto x, auto y) { return x + y; };
+    auto mul = [](auto x, auto y) { return x * y; };
+
+    // Pushes a comparison of FB with FA onto the integer stack.
+    auto compare = [&](const bool result) {
+        fpError |= !std::isfinite(FA.value) || !std::isfinite(FB.value);
+        fpPop();
+        fpPop();
+        C = B;
+        B = A;
+        A = result;
+    };
+
+    switch (opCode) {
+        /* ===== Loads ===== */
+        case 0x8E: // fpldnlsn - load the single at A
+            fpPush(loadSingle(A));
+            A = B;
+            B = C;
+            break;
+        case 0x8A: // fpldnldb - load the double at A
+            fpPush(loadDouble(A));
+            A = B;
+            B = C;
+            break;
+        case 0x86: // fpldnlsni - load single B of the array at A
+            fpPush(loadSingle(A + 4 * B));
+            A = C;
+            break;
+        case 0x82: // fpldnldbi - load double B of the array at A
+            fpPush(loadDouble(A + 8 * B));
+            A = C;
+            break;
+        case 0x9F: // fpldzerosn
+            fpPush(FpReg{0, true});
+            break;
+        case 0xA0: // fpldzerodb
+            fpPush(FpReg{0, false});
+            break;
+        case 0x96: { // fpi32tor32 - load the integer at A as a single
+            const int32_t word = readWord(A);
+            const float value = fpRounded(round, word, word,
+                                          [](int32_t x, int32_t) { return static_cast<float>(x); });
+            fpPush(FpReg{value, true});
+            A = B;
+            B = C;
+            break;
+        }
+        case 0x98: // fpi32tor64 - load the integer at A as a double, exactly
+            fpPush(FpReg{static_cast<double>(static_cast<int32_t>(readWord(A))), false});
+            A = B;
+            B = C;
+            break;
+        case 0xAA: // fpldnladdsn - FA := FA + the single at A
+            fpPush(loadSingle(A));
+            A = B;
+            B = C;
+            binary(add);
+            break;
+        case 0xA6: // fpldnladddb
+            fpPush(loadDouble(A));
+            A = B;
+            B = C;
+            binary(add);
+            break;
+        case 0xAC: // fpldnlmulsn - FA := FA * the single at A
+            fpPush(loadSingle(A));
+            A = B;
+            B = C;
+            binary(mul);
+            break;
+        case 0xA8: // fpldnlmuldb
+            fpPush(loadDouble(A));
+            A = B;
+            B = C;
+            binary(mul);
+            break;
+
+        /* ===== Stores ===== */
+        case 0x88: { // fpstnlsn - store FA as a single at A
+            const float value = fpRounded(round, FA.value, FA.value,
+                                          [](double x, double) { return static_cast<float>(x); });
+            fpError |= !std::isfinite(value);
+            writeWord(A, std::bit_cast<u32>(value));
+            fpPop();
+            A = B;
+            B = C;
+            break;
+        }
+        case 0x84: { // fpstnldb - store FA as a double at A
+            const u64 bits = std::bit_cast<u64>(FA.value);
+            writeWord(A, static_cast<u32>(bits));
+            writeWord(A + 4, static_cast<u32>(bits >> 32));
+            fpPop();
+            A = B;
+            B = C;
+            break;
+        }
+        case 0x9E: { // fpstnli32 - store FA, an integer value, as an integer at A
+            const bool fits = FA.value >= -2147483648.0 && FA.value <= 2147483647.0;
+            fpError |= !fits;
+            writeWord(A, fits ? static_cast<u32>(static_cast<int32_t>(FA.value)) : 0);
+            fpPop();
+            A = B;
+            B = C;
+            break;
+        }
+
+        /* ===== Arithmetic ===== */
+        case 0x87: // fpadd
+            binary(add);
+            break;
+        case 0x89: // fpsub
+            binary([](auto x, auto y) { return x - y; });
+            break;
+        case 0x8B: // fpmul
+            binary(mul);
+            break;
+        case 0x8C: // fpdiv
+            binary([](auto x, auto y) { return x / y; });
+            break;
+        case 0xA1: // fpint - round FA to an integer value
+            unary([](auto x) { return std::nearbyint(x); });
+            break;
+
+        /* ===== Stack ===== */
+        case 0xA3: // fpdup
+            fpPush(FA);
+            break;
+        case 0xA4: // fprev
+            std::swap(FA, FB);
+            break;
+
+        /* ===== Comparison and Errors ===== */
+        case 0x94: // fpgt - push FB > FA
+            compare(FB.value > FA.value);
+            break;
+        case 0x95: // fpeq - push FB = FA
+            compare(FB.value == FA.value);
+            break;
+        case 0x9C: // fptesterr - push whether no error occurred, and clear it
+            C = B;
+            B = A;
+            A = !fpError;
+            fpError = false;
+            break;
+
+        /* ===== Entry ===== */
+        case 0xAB: { // fpentry - the operation is in A
+            const u32 entry = A;
+            A = B;
+            B = C;
+
+            switch (entry) {
+                case 0x01: // fpusqrtfirst
+                case 0x02: // fpusqrtstep
+                    // The T800 takes a square root in steps; the last one
+                    // does all the work here.
+                    break;
+                case 0x03: // fpusqrtlast
+                    unary([](auto x) { return std::sqrt(x); });
+                    break;
+                case 0x04: // fpurp - round towards plus infinity
+                    fpRound = FE_UPWARD;
+                    break;
+                case 0x05: // fpurm - round towards minus infinity
+                    fpRound = FE_DOWNWARD;
+                    break;
+                case 0x06: // fpurz - round towards zero
+                    fpRound = FE_TOWARDZERO;
+                    break;
+                case 0x22: // fpurn - round to nearest
+                    fpRound = FE_TONEAREST;
+                    break;
+                case 0x07: // fpur32tor64
+                    FA.single = false;
+                    break;
+                case 0x08: // fpur64tor32
+                    FA.value = fpRounded(round, FA.value, FA.value,
+                                         [](double x, double) { return static_cast<float>(x); });
+                    FA.single = true;
+                    fpError |= !std::isfinite(FA.value);
+                    break;
+                case 0x0B: // fpuabs
+                    FA.value = std::fabs(FA.value);
+                    break;
+                case 0x11: // fpudivby2
+                    unary([](auto x) { return x / 2; });
+                    break;
+                case 0x12: // fpumulby2
+                    unary([](auto x) { return x * 2; });
+                    break;
+                case 0x23: // fpuseterr
+                    fpError = true;
+                    break;
+                case 0x9C: // fpuclrerr
+                    fpError = false;
+                    break;
+                default:
+                    throw BException("Attempted to execute unknown floating-point "
+                                     "entry %lu.", entry);
+            }
+            break;
+        }
     }
+}
+
+template void Transputer::runLoop<true>(u64& budget);
+template void Transputer::runLoop<false>(u64& budget);
+template void Transputer::runLoop<true, true>(u64& budget);
+template void Transputer::runLoop<false, true>(u64& budget);
+template void Transputer::doInstr<true>(const u8 instrCode);
+
+u32 Transputer::crcStep(u32 crc, u32 data, const u32 gen, const int nBytes) {
+    // The transputer shifts data into the CRC msb-first with an arbitrary
+    // generator, which rules out the reflected, fixed-polynomial crc32
+    // instruction of the host. Instead, we process a byte at a time through
+    // a table built for the generator last seen on this thread. Programs
+    // practically never switch generators, so the table is almost always hot.
+    thread_local u32 genCached = 0;
+    thread_local u32 table[256] = {0};
+
+    if (gen != genCached) {
+        for (u32 top = 0; top < 256; ++top) {
+            u32 reg = top << 24;
+            for (int bit = 0; bit < 8; ++bit) {
+                reg = (reg & 0x80000000) ? (reg << 1) ^ gen : (reg << 1);
+            }
+            table[top] = reg;
+        }
+        genCached = gen;
+    }
+
+    for (int i = 0; i < nBytes; ++i) {
+        crc = (crc << 8) ^ (data >> 24) ^ table[crc >> 24];
+        data <<= 8;
+    }
+
+    return crc;
 }
\ No newline at end of file
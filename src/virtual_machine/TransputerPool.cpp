@@ -0,0 +1,98 @@
+#include "include/TransputerPool.h"
+
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+#include <thread>
+
+namespace {
+    /// Reads the CPUs of NUMA node @node from sysfs into @cpus. Returns false
+    /// if the node is unknown, e.g. on machines without NUMA support.
+    bool nodeCpus(const int node, cpu_set_t& cpus) {
+        std::ifstream cpuList("/sys/devices/system/node/node" +
+                              std::to_string(node) + "/cpulist");
+        std::string list;
+        if (!std::getline(cpuList, list)) return false;
+
+        // The list is a comma separated sequence of CPUs and ranges,
+        // e.g. "0-3,8-11".
+        CPU_ZERO(&cpus);
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ',')) {
+            const size_t dash = range.find('-');
+            const int lo = std::stoi(range.substr(0, dash));
+            const int hi = dash == std::string::npos
+                ? lo : std::stoi(range.substr(dash + 1));
+            for (int cpu = lo; cpu <= hi; ++cpu) CPU_SET(cpu, &cpus);
+        }
+
+        return true;
+    }
+}
+
+TransputerPool::TransputerPool(
+  const u32 capacity,
+  const u32 _memSize,
+  const int _numaNode):
+  memSize(_memSize),
+  numaNode(_numaNode) {
+    allInstances.reserve(capacity);
+    freeList.reserve(capacity);
+    warm(capacity);
+}
+
+void TransputerPool::warm(const u32 count) {
+    std::vector<std::unique_ptr<Transputer>> built;
+    built.reserve(count);
+
+    auto build = [&]() {
+        if (numaNode != ANY_NODE) {
+            cpu_set_t cpus;
+            if (nodeCpus(numaNode, cpus)) {
+                sched_setaffinity(0, sizeof(cpus), &cpus);
+            }
+        }
+
+        for (u32 i = 0; i < count; ++i) {
+            auto vm = std::make_unique<Transputer>(memSize);
+            vm->ensureMemory();
+            built.push_back(std::move(vm));
+        }
+    };
+
+    // Pinning is done on a scratch thread so that the caller's affinity is
+    // left untouched.
+    if (numaNode != ANY_NODE) std::thread(build).join();
+    else build();
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    for (auto& vm: built) {
+        freeList.push_back(vm.get());
+        allInstances.push_back(std::move(vm));
+    }
+}
+
+Transputer* TransputerPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (!freeList.empty()) {
+            Transputer *vm = freeList.back();
+            freeList.pop_back();
+            return vm;
+        }
+    }
+
+    warm(1);
+    return acquire();
+}
+
+void TransputerPool::release(Transputer *vm) {
+    // Reset outside the lock - it only touches the instance itself.
+    vm->unloadProgram();
+    vm->setLinkHandlers(LinkHandlers{});
+    vm->setProfile(nullptr);
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    freeList.push_back(vm);
+}
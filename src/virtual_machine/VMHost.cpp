@@ -0,0 +1,64 @@
+#include "include/VMHost.h"
+
+VMHandle VMHost::create(const u32 memSize) {
+    u32 idx;
+
+    if (freeHead != NO_SLOT) {
+        idx = freeHead;
+        freeHead = slotAt(idx).nextFree;
+    } else {
+        if (slotCount % CHUNK_SIZE == 0) {
+            chunks.push_back(std::make_unique<Slot[]>(CHUNK_SIZE));
+        }
+        idx = slotCount++;
+    }
+
+    Slot& slot = slotAt(idx);
+    slot.vm.emplace(memSize);
+    liveCount++;
+
+    return (static_cast<u64>(slot.generation) << 32) | idx;
+}
+
+void VMHost::destroy(const VMHandle handle) {
+    get(handle);
+
+    const u32 idx = static_cast<u32>(handle);
+    Slot& slot = slotAt(idx);
+
+    slot.vm.reset();
+    slot.generation++;
+    slot.nextFree = freeHead;
+    freeHead = idx;
+    liveCount--;
+}
+
+Transputer& VMHost::get(const VMHandle handle) {
+    const u32 idx = static_cast<u32>(handle);
+    const u32 generation = static_cast<u32>(handle >> 32);
+
+    if (idx >= slotCount || slotAt(idx).generation != generation ||
+        !slotAt(idx).vm) {
+        throw BException("Invalid VM handle %llu - the instance does not "
+                         "exist or was destroyed.",
+                         static_cast<unsigned long long>(handle));
+    }
+
+    return *slotAt(idx).vm;
+}
+
+RunResult VMHost::run(const VMHandle handle, const u64 budget) {
+    Transputer& vm = get(handle);
+    const u64 ticksBefore = vm.getTickCount();
+
+    RunResult result;
+    try {
+        result.status = vm.run(budget);
+    } catch (const BException& e) {
+        result.status = RunStatus::Faulted;
+        result.error = e.msg;
+    }
+    result.ticks = vm.getTickCount() - ticksBefore;
+
+    return result;
+}
@@ -0,0 +1,202 @@
+#include "include/Verifier.h"
+
+#include <algorithm>
+#include <optional>
+
+#include "auxlib/BException.h"
+
+bool Verifier::isKnownOp(const u32 opCode) {
+    switch (opCode) {
+        case 0x0: case 0x1: case 0x2: case 0x3: case 0x4: case 0x5: case 0x6:
+        case 0x7: case 0x8: case 0x9: case 0xA: case 0xB: case 0xC:
+        case 0x20: // ret
+        case 0x4A: case 0x74: case 0x75: case 0xF0:
+            return true;
+        default:
+            return isFloatOp(opCode);
+    }
+}
+
+bool Verifier::isFloatOp(const u32 opCode) {
+    switch (opCode) {
+        case 0x82: case 0x84: case 0x86: case 0x87: case 0x88: case 0x89:
+        case 0x8A: case 0x8B: case 0x8C: case 0x8E:
+        case 0x94: case 0x95: case 0x96: case 0x98: case 0x9C: case 0x9E:
+        case 0x9F: case 0xA0: case 0xA1: case 0xA3: case 0xA4: case 0xA6:
+        case 0xA8: case 0xAA: case 0xAB: case 0xAC:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Verifier::decode(
+  const std::vector<u8>& image,
+  std::vector<DecodedInstr>& instrs) {
+    u32 O = 0;
+    u32 start = 0;
+
+    // Mirrors the operand register handling of Transputer::doInstr.
+    for (u32 i = 0; i < image.size(); ++i) {
+        const u8 code = image[i] >> 4;
+        const u32 oper = O | (image[i] & 0xF);
+
+        if (code == 0x0) {
+            O = oper << 4;
+        } else if (code == 0x1) {
+            O = (~oper) << 4;
+        } else {
+            instrs.push_back({start, i + 1, code, oper});
+            O = 0;
+            start = i + 1;
+        }
+    }
+
+    return start == image.size();
+}
+
+VerifyResult Verifier::verify(const std::vector<u8>& image, const u32 wsBytes) {
+    const u32 size = image.size();
+    VerifyResult result{false, "",
+        std::vector<u32>(size + 1, VerifyResult::NOT_RET_TARGET), 0};
+
+    auto fail = [&](const char *what, const u32 offset) {
+        result.error = BException("Cannot verify image - %s at offset %lu.",
+                                  what, offset).msg;
+        return result;
+    };
+
+    std::vector<DecodedInstr> instrs;
+    if (!decode(image, instrs)) return fail("truncated prefix chain", size);
+
+    // Index of the instruction starting at each offset, if any. The end of
+    // the image is a valid target too - reaching it halts.
+    constexpr u32 NONE = ~0u;
+    std::vector<u32> instrAt(size + 1, NONE);
+    for (u32 idx = 0; idx < instrs.size(); ++idx) instrAt[instrs[idx].start] = idx;
+
+    // Workspace pointer relative to its initial value, in words, on entry to
+    // each instruction, and the routine it belongs to: the offset of the
+    // call target it is reached from, or NONE for the main program.
+    std::vector<std::optional<int64_t>> wsAt(instrs.size());
+    std::vector<u32> routineAt(instrs.size(), NONE);
+    std::vector<u32> worklist;
+
+    // Workspace each routine is entered at, by call target offset.
+    std::vector<std::optional<int64_t>> entryWs(size + 1);
+
+    struct Ret {
+        u32 offset;
+        int64_t ws;
+        u32 routine;
+    };
+    std::vector<Ret> rets;
+
+    auto flowTo = [&](const int64_t target, const int64_t ws,
+                      const u32 routine, const u32 from) {
+        if (target < 0 || target > size) return false;
+        if (target == size) return true;
+
+        const u32 idx = instrAt[target];
+        if (idx == NONE) return false;
+
+        if (!wsAt[idx]) {
+            wsAt[idx] = ws;
+            routineAt[idx] = routine;
+            worklist.push_back(idx);
+        } else if (*wsAt[idx] != ws) {
+            fail("inconsistent workspace", from);
+            return false;
+        } else if (routineAt[idx] != routine) {
+            fail("code shared between routines", from);
+            return false;
+        }
+        return true;
+    };
+
+    auto inWorkspace = [&](const int64_t word) {
+        if (word < 0 || (word + 1) * 4 > static_cast<int64_t>(wsBytes)) return false;
+        result.wsHigh = std::max<u32>(result.wsHigh, (word + 1) * 4);
+        return true;
+    };
+
+    if (!instrs.empty()) {
+        wsAt[0] = 0;
+        worklist.push_back(0);
+    }
+
+    while (!worklist.empty()) {
+        const u32 idx = worklist.back();
+        worklist.pop_back();
+
+        const DecodedInstr& instr = instrs[idx];
+        const int64_t ws = *wsAt[idx];
+        const u32 routine = routineAt[idx];
+        const int64_t imm = static_cast<int32_t>(instr.oper);
+        const int64_t next = instr.end;
+
+        // flowTo records its own failure for workspace conflicts.
+        auto flow = [&](const int64_t target, const int64_t newWs,
+                        const u32 newRoutine) {
+            if (flowTo(target, newWs, newRoutine, instr.start)) return true;
+            if (result.error.empty()) fail("jump to an invalid target", instr.start);
+            return false;
+        };
+
+        switch (instr.code) {
+            case 0x3: // ldl
+            case 0x4: // stl
+            case 0x5: // ldlp
+                if (!inWorkspace(ws + imm))
+                    return fail("workspace access out of bounds", instr.start);
+                if (!flow(next, ws, routine)) return result;
+                break;
+            case 0x9: // j
+                if (!flow(next + imm, ws, routine)) return result;
+                break;
+            case 0xA: // cj
+                if (!flow(next + imm, ws, routine) || !flow(next, ws, routine))
+                    return result;
+                break;
+            case 0xE: { // call
+                const int64_t target = next + imm;
+                if (target < 0 || target > size)
+                    return fail("jump to an invalid target", instr.start);
+                if (entryWs[target] && *entryWs[target] != ws - 4)
+                    return fail("call at inconsistent workspace", instr.start);
+                entryWs[target] = ws - 4;
+                if (!inWorkspace(ws - 4) || !inWorkspace(ws - 1))
+                    return fail("call frame out of bounds", instr.start);
+                result.retTargets[next] = static_cast<u32>(ws * 4);
+                if (!flow(target, ws - 4, target) || !flow(next, ws, routine))
+                    return result;
+                break;
+            }
+            case 0xF: // ajw
+                if (!flow(next, ws + imm, routine)) return result;
+                break;
+            case 0x2: // opr
+                if (!isKnownOp(instr.oper))
+                    return fail("unknown operation", instr.start);
+                if (instr.oper == 0x20) {
+                    rets.push_back({instr.start, ws, routine});
+                } else if (!flow(next, ws, routine)) {
+                    return result;
+                }
+                break;
+            default:
+                if (!flow(next, ws, routine)) return result;
+                break;
+        }
+    }
+
+    // A balanced ret is back at the workspace its routine was entered at.
+    // The main program was not called, so it has nothing to return to.
+    for (const Ret& ret: rets) {
+        if (ret.routine == NONE || ret.ws != *entryWs[ret.routine])
+            return fail("ret at unbalanced workspace", ret.offset);
+    }
+
+    result.ok = true;
+    return result;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "auxlib/Types.h"
+
+#include "Transputer.h"
+
+/// One program run of a batch.
+struct BatchJob {
+    std::string image;
+    u64 budget = 1000000;
+    u32 memSize = Transputer::DEFAULT_MEM_SIZE;
+
+    /// Words fed to the program on link 0.
+    std::vector<u32> input;
+
+    /// Words the program must send on link 0. Only checked if @checkOutput.
+    std::vector<u32> expected;
+    bool checkOutput = false;
+};
+
+struct BatchResult {
+    bool passed;
+    RunStatus status;
+    u64 ticks;
+    u64 latencyNs;             // Load to halt, on the worker.
+    std::vector<u32> output;
+    std::string error;         // Why the job failed, if it did.
+};
+
+struct BatchReport {
+    std::vector<BatchResult> results;  // In manifest order.
+    u32 passed;
+    u32 failed;
+    u64 ticks;
+    double seconds;                    // Wall clock for the whole batch.
+
+    /// Instructions per microsecond, across all workers.
+    double mips() const { return seconds > 0 ? ticks / seconds / 1e6 : 0; }
+
+    /// Job latency at percentile @p (0-100), by nearest rank.
+    u64 latencyPercentile(const double p) const;
+
+    /// Writes pass/fail per job and the aggregate figures.
+    void print(std::ostream& out, const std::vector<BatchJob>& jobs) const;
+};
+
+/// Runs a list of programs across a fixed pool of worker threads.
+///
+/// Each worker keeps one Transputer and reloads it for every job, so memory
+/// is allocated once per worker and only dirtied pages are cleared between
+/// jobs. Images are mapped once and shared by all workers.
+///
+/// A manifest has one job per line: an image path followed by options, e.g.
+///
+///     # image           options
+///     tests/sum.bin     in=1,2,3 out=6 budget=5000
+///     tests/big.bin     mem=1048576
+///
+/// `in` and `out` are comma separated words fed to and expected on link 0,
+/// `budget` caps the instructions run and `mem` sets the memory size, which
+/// must be non-zero and at most Transputer::LINK_OUT_BASE. A job passes if
+/// it halts within its budget without faulting and, if `out` is given, sends
+/// exactly those words. Blank lines and lines starting with # are skipped.
+class BatchRunner {
+  public:
+    /// Reads the manifest at @path. Relative image paths are taken relative
+    /// to the manifest. Throws on malformed lines.
+    static std::vector<BatchJob> parseManifest(const std::string& path);
+
+    /// Runs @jobs on @threads workers, or one per core if 0.
+    static BatchReport run(const std::vector<BatchJob>& jobs, u32 threads = 0);
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "auxlib/Types.h"
+
+#include "Transputer.h"
+
+/// An iserver-style host, serving file and console requests that programs
+/// send on link 0.
+///
+/// A request is a tag word followed by its arguments; the reply starts with
+/// a result word (SP_SUCCESS, SP_UNIMPLEMENTED or SP_ERROR):
+///
+///     SP_OPEN   name, nameLen, mode  ->  result, stream
+///     SP_CLOSE  stream               ->  result
+///     SP_READ   stream, addr, len    ->  result, count
+///     SP_WRITE  stream, addr, len    ->  result, count
+///     SP_SEEK   stream, offset, whence ->  result
+///     SP_TELL   stream               ->  result, position
+///     SP_EXIT   status               ->  result
+///
+/// Names and buffers are given by address in the program's memory. Streams
+/// 0, 1 and 2 are the console's input, output and error. Open modes are
+/// OPEN_READ, OPEN_WRITE (create or truncate), OPEN_APPEND and
+/// OPEN_UPDATE (read and write); seeks take lseek's SEEK_SET, SEEK_CUR and
+/// SEEK_END.
+///
+/// Requests are served on the server's own thread. Sending one never
+/// blocks the program, so it can keep working until it reads the reply;
+/// only then, if the reply is not in yet, does Transputer::run return
+/// Blocked, leaving the host free to run other instances. The server takes
+/// all requests queued while it was busy in one batch, and reads and writes
+/// move data directly between files and emulated memory. As with DMA, the
+/// program must leave a buffer alone until the reply arrives. A read into
+/// the program image faults the program.
+class HostServer {
+  public:
+    static constexpr u32 SP_OPEN  = 10;
+    static constexpr u32 SP_CLOSE = 11;
+    static constexpr u32 SP_READ  = 12;
+    static constexpr u32 SP_WRITE = 13;
+    static constexpr u32 SP_SEEK  = 17;
+    static constexpr u32 SP_TELL  = 18;
+    static constexpr u32 SP_EXIT  = 35;
+
+    static constexpr u32 SP_SUCCESS       = 0;
+    static constexpr u32 SP_UNIMPLEMENTED = 1;
+    static constexpr u32 SP_ERROR         = 128;
+
+    static constexpr u32 OPEN_READ   = 0;
+    static constexpr u32 OPEN_WRITE  = 1;
+    static constexpr u32 OPEN_APPEND = 2;
+    static constexpr u32 OPEN_UPDATE = 3;
+
+    /// Serves console streams from the host's @consoleIn, @consoleOut and
+    /// @consoleErr file descriptors.
+    HostServer(const int consoleIn = 0, const int consoleOut = 1, const int consoleErr = 2);
+
+    HostServer(const HostServer&) = delete;
+    HostServer& operator=(const HostServer&) = delete;
+    ~HostServer();
+
+    class Client;
+
+  private:
+    struct ClientState;
+
+    /// A complete request, decoded on the program's thread.
+    struct Request {
+        std::shared_ptr<ClientState> client;
+        u32 tag;
+        u32 args[3];
+        std::string name;          // SP_OPEN.
+        u8 *buffer = nullptr;      // SP_READ / SP_WRITE, checked in bounds.
+    };
+
+    const int consoleFds[3];
+
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::vector<Request> queue;
+    bool stopping = false;
+
+    std::thread thread;
+
+    void submit(Request&& request);
+    void serve();
+    void handle(Request& request);
+};
+
+/// State shared between a Client and the server thread.
+struct HostServer::ClientState {
+    Transputer *vm;
+
+    std::mutex replyMutex;
+    std::condition_variable replyReady;
+    std::deque<std::vector<u32>> replies;
+    size_t replyPos = 0;
+    u32 inFlight = 0;
+    std::optional<u32> exitStatus;
+
+    // Server thread only.
+    std::vector<int> fds;
+};
+
+/// One program's connection to a HostServer. Install handlers() on the
+/// program's Transputer; the Client must outlive its use there. Call reset()
+/// before resetting the Transputer or handing it to another program, so
+/// that no request still being served writes into its memory.
+class HostServer::Client {
+  public:
+    Client(HostServer& _server, Transputer& vm);
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    /// Waits for requests still being served, then closes the program's
+    /// files.
+    ~Client();
+
+    /// Link handlers that connect link 0 to the server. Transfers on the
+    /// other links block.
+    LinkHandlers handlers();
+
+    /// Returns true if a reply is waiting to be read by the program.
+    bool replyReady();
+
+    /// Waits until a reply is waiting, e.g. after run returned Blocked.
+    void waitForReply();
+
+    /// The status the program passed to SP_EXIT, if it did.
+    std::optional<u32> exitStatus();
+
+    /// Waits for requests still being served, then drops the replies the
+    /// program has not read and any request it was partway through
+    /// sending. The program's files stay open.
+    void reset();
+
+  private:
+    HostServer& server;
+    std::shared_ptr<ClientState> state;
+
+    /// Words of the request being sent.
+    std::vector<u32> pending;
+
+    static bool linkIn(void *ctx, u32 link, u32& word);
+    static bool linkOut(void *ctx, u32 link, u32 word);
+};
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
 #include <cassert>
+#include <cstring>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <iostream>
 #include <vector>
 #include <string>
 
@@ -12,12 +16,17 @@
 
 class Memory {
   public:
+    Memory() = default;
+
+    Memory(const u32 N):
+      memData(std::vector<u8>(N, 0)) {}
+
     u32 __attribute__((always_inline))
-    getSize() { 
+    getSize() {
         return memData.size();
     }
 
-    void __attribute__((always_inline)) 
+    void __attribute__((always_inline))
     checkByteAccess(const u32 byteIdx) {
         if (byteIdx >= getSize())
             throw BException("Attempted to read byte from memory at position "
@@ -26,7 +35,7 @@ class Memory {
 
     void __attribute__((always_inline))
     checkWordAccess(const u32 addr) {
-        if (addr >= getSize() - 3)
+        if (getSize() < 4 || addr > getSize() - 4)
             throw BException("Attempted to read word from memory at position "
                              "%lu, which is out of bounds.", addr);
 
@@ -35,62 +44,274 @@ class Memory {
                              "%lu, which is not aligned.", addr);
     }
 
+    /// Checks a whole block [addr, addr + len) once, so that block operations
+    /// can run on raw pointers without per-byte checks afterwards.
+    void __attribute__((always_inline))
+    checkBlockAccess(const u32 addr, const u32 len) {
+        if (len > getSize() || addr > getSize() - len)
+            throw BException("Attempted to access block of %lu bytes at "
+                             "position %lu, which is out of bounds.",
+                             len, addr);
+    }
+
+    /// readWord for addresses proven in bounds and aligned ahead of time,
+    /// e.g. by the Verifier.
+    u32 __attribute__((always_inline))
+    readWordUnchecked(const u32 addr) {
+        u32 word;
+        std::memcpy(&word, memData.data() + addr, sizeof(word));
+
+        return fromLittleEndian(word);
+    }
+
     void dumpContents() {
-        for (u32 i = 0; i < )
+        for (u32 i = 0; i < getSize(); i += 16) {
+            fprintf(stderr, "%08x:", i);
+            for (u32 j = i; j < i + 16 && j < getSize(); ++j) {
+                fprintf(stderr, " %02x", memData[j]);
+            }
+            fprintf(stderr, "\n");
+        }
     }
 
   protected:
     std::vector<u8> memData;
-}
+
+    /// The transputer is little-endian, and memory holds words in that layout
+    /// regardless of the host. Conversions compile away on little-endian
+    /// hosts and become a single bswap on big-endian ones.
+    static constexpr u32 __attribute__((always_inline))
+    fromLittleEndian(const u32 word) {
+        if constexpr (std::endian::native == std::endian::big) {
+            return __builtin_bswap32(word);
+        } else {
+            return word;
+        }
+    }
+
+    static constexpr u32 __attribute__((always_inline))
+    toLittleEndian(const u32 word) {
+        return fromLittleEndian(word);
+    }
+};
 
 class ReadableMemory: public Memory {
   public:
-    ReadableMemory = default;
+    ReadableMemory() = default;
+
+    ReadableMemory(const u32 N):
+      Memory(N) {}
 
     u8 readByte(const u32 byteIdx) {
         checkByteAccess(byteIdx);
 
-        return memData[byteIdx]; 
+        return memData[byteIdx];
     }
 
     u32 readWord(const u32 addr) {
         checkWordAccess(addr);
 
-        u32 word = 0;
-        for (int i = 0; i < 4; ++i) {
-            word |= getByte(addr + i);
-            word <<= 8;
-        } 
+        // memcpy is the portable unaligned-safe load; it compiles to a single
+        // mov on the hosts we care about.
+        u32 word;
+        std::memcpy(&word, &memData[addr], sizeof(word));
 
-        return word;
-    }  
+        return fromLittleEndian(word);
+    }
 };
 
 class WriteableMemory: public ReadableMemory {
   public:
-    WriteableMemory = default;
+    WriteableMemory() = default;
 
-    WriteableMemory(const int N):
-      memData(std::vector<u8>(N, 0)) {}
-      
-    void writeByte(const u32 byteIdx, const u8 byte) { 
+    static constexpr u32 PAGE_SHIFT = 12;
+    static constexpr u32 PAGE_SIZE  = 1 << PAGE_SHIFT;
+
+    WriteableMemory(const u32 N):
+      ReadableMemory(N),
+      dirtyPages(((N >> PAGE_SHIFT) + 1 + 63) / 64, 0),
+      codePages(dirtyPages.size(), 0) {}
+
+    void writeByte(const u32 byteIdx, const u8 byte) {
         checkByteAccess(byteIdx);
 
-        mem[byteIdx] = byte;
+        markWritten(byteIdx);
+        memData[byteIdx] = byte;
     }
 
-    void setWord(const u32 addr, u32 word) {
+    void writeWord(const u32 addr, const u32 word) {
         checkWordAccess(addr);
 
-        for (int i = 0; i < 4; ++i) {
-            mem[addr + i] = word & 0xFF;
-            word >>= 8;
+        markWritten(addr);
+        const u32 leWord = toLittleEndian(word);
+        std::memcpy(&memData[addr], &leWord, sizeof(leWord));
+    }
+
+    /// writeWord for addresses proven in bounds and aligned ahead of time.
+    void __attribute__((always_inline))
+    writeWordUnchecked(const u32 addr, const u32 word) {
+        markWritten(addr);
+        const u32 leWord = toLittleEndian(word);
+        std::memcpy(memData.data() + addr, &leWord, sizeof(leWord));
+    }
+
+    /// Copies @len bytes from the host buffer @src to @addr, e.g. to load a
+    /// program image.
+    void writeBlock(const u32 addr, const u8 *src, const u32 len) {
+        if (len == 0) return;
+
+        checkBlockAccess(addr, len);
+        markWritten(addr, len);
+        std::memcpy(&memData[addr], src, len);
+    }
+
+    /// Pointer to @len bytes at @addr, for callers that check the whole
+    /// range up front.
+    u8* blockPtr(const u32 addr, const u32 len) {
+        checkBlockAccess(addr, len);
+        return memData.data() + addr;
+    }
+
+    /// Records a write of [addr, addr + len) made through blockPtr, as if
+    /// it had gone through writeBlock.
+    void wroteBlock(const u32 addr, const u32 len) {
+        if (len == 0) return;
+
+        checkBlockAccess(addr, len);
+        markWritten(addr, len);
+    }
+
+    /* ===== Code Pages ===== */
+    // Pages holding decoded code are flagged, so that a store to one of them
+    // can be reported to whoever cached the decoded instructions. The flag is
+    // dropped on the first such store, so later stores to the page are cheap
+    // again until its code is decoded anew.
+
+    void markCode(const u32 addr, const u32 len) {
+        for (u32 page = addr >> PAGE_SHIFT;
+             page <= (addr + len - 1) >> PAGE_SHIFT; ++page) {
+            codePages[page / 64] |= 1ull << (page % 64);
+        }
+    }
+
+    /// Returns true if code pages were written since the last call to
+    /// takeWrittenCode.
+    bool codeWritten() const { return !writtenCode.empty(); }
+
+    /// Returns the code pages written since the last call, and forgets them.
+    std::vector<u32> takeWrittenCode() {
+        std::vector<u32> pages;
+        pages.swap(writtenCode);
+        return pages;
+    }
+
+    void clearCodePages() {
+        std::fill(codePages.begin(), codePages.end(), 0);
+        writtenCode.clear();
+    }
+
+    /// Copies @len bytes from @src to @dst. The ranges may overlap, in which
+    /// case the result is as if the source was first copied to a temporary.
+    void moveBlock(const u32 dst, const u32 src, const u32 len) {
+        if (len == 0) return;
+
+        checkBlockAccess(src, len);
+        checkBlockAccess(dst, len);
+        markWritten(dst, len);
+
+        // memmove is already vectorised by libc for the host (AVX2 / ERMS
+        // `rep movsb` on x86), so there is nothing to gain from hand-rolling
+        // it here once the bounds have been checked.
+        std::memmove(&memData[dst], &memData[src], len);
+    }
+
+    /// Zeroes @len bytes starting at @addr.
+    void clearBlock(const u32 addr, const u32 len) {
+        if (len == 0) return;
+
+        checkBlockAccess(addr, len);
+        checkCode(addr, len);
+        std::memset(&memData[addr], 0, len);
+    }
+
+    /// Zeroes only the pages written since the last reset, which for short
+    /// runs is a small fraction of the memory.
+    void resetDirty() {
+        for (u32 i = 0; i < dirtyPages.size(); ++i) {
+            for (u64 bits = dirtyPages[i]; bits != 0; bits &= bits - 1) {
+                const u32 page = i * 64 + __builtin_ctzll(bits);
+                const u32 start = page << PAGE_SHIFT;
+                const u32 len = std::min(PAGE_SIZE, getSize() - start);
+                std::memset(&memData[start], 0, len);
+            }
+            dirtyPages[i] = 0;
         }
     }
 
+    /// Flags the pages of [addr, addr + len) as dirty, for writers that
+    /// bypass this class. Unlike a write, this does not report code pages,
+    /// so the range must not hold code.
+    void markDirty(const u32 addr, const u32 len) {
+        if (len == 0) return;
+
+        for (u32 page = addr >> PAGE_SHIFT;
+             page <= (addr + len - 1) >> PAGE_SHIFT; ++page) {
+            dirtyPages[page / 64] |= 1ull << (page % 64);
+        }
+    }
+
+    /// Returns true if the page containing @addr was written since the last
+    /// reset.
+    bool isDirty(const u32 addr) const {
+        const u32 page = addr >> PAGE_SHIFT;
+        return (dirtyPages[page / 64] >> (page % 64)) & 1;
+    }
+
     void clearMemory() {
-        for (u8 &byte: memData) {
-            byte = 0x0;
+        std::fill(memData.begin(), memData.end(), 0);
+        std::fill(dirtyPages.begin(), dirtyPages.end(), 0);
+        clearCodePages();
+    }
+
+  private:
+    /// One bit per page, set when the page may hold a non-zero byte. Block
+    /// clears leave it alone, as they cannot make a clean page dirty.
+    std::vector<u64> dirtyPages;
+
+    /// One bit per page holding decoded code, and the flagged pages written
+    /// since they were last collected.
+    std::vector<u64> codePages;
+    std::vector<u32> writtenCode;
+
+    void __attribute__((always_inline))
+    markWritten(const u32 addr) {
+        const u32 page = addr >> PAGE_SHIFT;
+        const u64 bit = 1ull << (page % 64);
+        dirtyPages[page / 64] |= bit;
+
+        if (codePages[page / 64] & bit) [[unlikely]] {
+            codePages[page / 64] &= ~bit;
+            writtenCode.push_back(page);
+        }
+    }
+
+    void markWritten(const u32 addr, const u32 len) {
+        for (u32 page = addr >> PAGE_SHIFT;
+             page <= (addr + len - 1) >> PAGE_SHIFT; ++page) {
+            markWritten(page << PAGE_SHIFT);
+        }
+    }
+
+    /// Reports the code pages in a range that is being zeroed. Unlike the
+    /// other writes, this leaves the dirty bits alone.
+    void checkCode(const u32 addr, const u32 len) {
+        for (u32 page = addr >> PAGE_SHIFT;
+             page <= (addr + len - 1) >> PAGE_SHIFT; ++page) {
+            const u64 bit = 1ull << (page % 64);
+            if (codePages[page / 64] & bit) {
+                codePages[page / 64] &= ~bit;
+                writtenCode.push_back(page);
+            }
         }
     }
 };
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "auxlib/Types.h"
+
+/// Host hardware events that PerfCounters can count.
+enum class PerfEvent : u8 {
+    Cycles,
+    Instructions,
+    BranchMisses,
+    L1DMisses,      // L1 data cache read misses.
+    LLCMisses,      // Last level cache read misses.
+    ITLBMisses,
+};
+
+static constexpr u32 PERF_EVENT_COUNT = 6;
+
+/// A reading of the host clock and of every event. Events the host cannot
+/// count stay at 0.
+struct PerfSample {
+    u64 nanos = 0;
+    u64 events[PERF_EVENT_COUNT] = {};
+
+    u64 operator[](const PerfEvent event) const {
+        return events[static_cast<u32>(event)];
+    }
+
+    PerfSample& operator+=(const PerfSample& other);
+
+    /// Adds @after - @before - @overhead, clamping each figure at 0, so that
+    /// the cost of taking the readings is not charged to what they enclose.
+    void addDelta(const PerfSample& after, const PerfSample& before, const PerfSample& overhead);
+};
+
+/// Counts hardware events on the calling thread with perf_event_open, in
+/// user mode only.
+///
+/// All events are opened as one group and read together with a single
+/// syscall. Hosts often refuse some or all of them - there may be no PMU in
+/// a VM, perf_event_paranoid may forbid it, or a container's seccomp policy
+/// may block the syscall. Events that fail to open are left out, and a
+/// reading then holds the monotonic clock alone, which is always there.
+///
+/// Counters belong to the thread that created them; read them on that
+/// thread only.
+class PerfCounters {
+  public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /// Returns true if @event is being counted.
+    bool has(const PerfEvent event) const { return slot[static_cast<u32>(event)] >= 0; }
+
+    /// Returns true if any hardware event is being counted.
+    bool hasHardware() const { return opened > 0; }
+
+    /// Takes a reading now.
+    void read(PerfSample& sample) const;
+
+    /// The smallest cost of one read(), measured when the counters were
+    /// opened, to subtract from readings taken around short stretches.
+    const PerfSample& readOverhead() const { return overhead; }
+
+    static const char* name(const PerfEvent event);
+
+  private:
+    /// Group leader, or -1 if no event could be opened.
+    int leaderFd = -1;
+    int fds[PERF_EVENT_COUNT];
+    u32 opened = 0;
+
+    /// Position of each event in a group read, or -1 if it is not counted.
+    int slot[PERF_EVENT_COUNT];
+
+    PerfSample overhead;
+
+    void calibrate();
+};
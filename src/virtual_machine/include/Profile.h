@@ -0,0 +1,89 @@
+#pragma once
+
+#include <ostream>
+#include <unordered_map>
+
+#include "auxlib/Types.h"
+
+#include "PerfCounters.h"
+#include "Verifier.h"
+
+/// Broad kinds of instruction, to break host costs down by.
+enum class OpClass : u8 {
+    Local,       // ldl, stl, ldlp, ajw
+    Constant,    // ldc, adc, eqc
+    NonLocal,    // ldnl, stnl, ldnlp - including link transfers
+    Jump,        // j, cj
+    Call,        // call, ret
+    Arithmetic,  // the operations from rev to shr
+    BlockOp,     // move, blkclr, crcword, crcbyte
+    Float,       // the T800 floating-point operations
+    Other,       // any other operation
+};
+
+static constexpr u32 OP_CLASS_COUNT = 9;
+
+struct ProfileEntry {
+    u64 execs = 0;     // Instructions executed, or entries for a block.
+    u64 ticks = 0;     // Emulated instructions, counting prefixes.
+    PerfSample cost;   // Host clock and events spent on them.
+};
+
+/// Host costs of running a program, per emulated instruction, broken down
+/// by opcode class and by basic block. Attach with Transputer::setProfile.
+///
+/// Readings are taken around every block, or around every instruction at
+/// Instruction granularity, and the cost of a reading is subtracted from
+/// each. Only Instruction granularity measures opcode classes; Block
+/// granularity counts them, and perturbs the run far less. Either way,
+/// reading the counters is a syscall, so absolute figures are inflated -
+/// compare them against each other, not against an unprofiled run.
+///
+/// Counters measure the thread that built the Profile, which must be the
+/// one running the program.
+class Profile {
+  public:
+    enum class Granularity : u8 { Block, Instruction };
+
+    explicit Profile(const Granularity _granularity = Granularity::Block):
+      granularity(_granularity) {}
+
+    static OpClass classify(const u8 code, const u32 oper);
+    static const char* name(const OpClass opClass);
+
+    const PerfCounters& getCounters() const { return counters; }
+    Granularity getGranularity() const { return granularity; }
+
+    /// Everything measured; @execs counts instructions.
+    const ProfileEntry& getTotal() const { return total; }
+
+    const ProfileEntry& getClass(const OpClass opClass) const {
+        return classes[static_cast<u32>(opClass)];
+    }
+
+    /// Blocks by start address.
+    const std::unordered_map<u32, ProfileEntry>& getBlocks() const { return blocks; }
+
+    /// Writes the figures per emulated instruction, overall, per opcode
+    /// class and for the @topBlocks blocks that cost the most.
+    void print(std::ostream& out, const u32 topBlocks = 10) const;
+
+  private:
+    friend class Transputer;
+
+    const Granularity granularity;
+    PerfCounters counters;
+
+    ProfileEntry total;
+    ProfileEntry classes[OP_CLASS_COUNT];
+    std::unordered_map<u32, ProfileEntry> blocks;
+
+    ProfileEntry *block = nullptr;  // The block being run.
+    PerfSample last;                // Reading at the start of what runs next.
+
+    /// Hooks for the interpreter, around each block it runs and after each
+    /// instruction it completes.
+    void enterBlock(const u32 addr);
+    void retire(const DecodedInstr& instr);
+    void leaveBlock();
+};
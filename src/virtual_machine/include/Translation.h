@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "auxlib/Types.h"
+
+#include "XlatAbi.h"
+
+/// A shared object produced by xlat and compiled by the host compiler,
+/// loaded and indexed for dispatch.
+///
+/// One Translation can back any number of instances running the same image,
+/// so hosts load it once and attach it to each with
+/// Transputer::attachTranslation.
+class Translation {
+  public:
+    Translation(const Translation&) = delete;
+    Translation& operator=(const Translation&) = delete;
+    ~Translation();
+
+    /// Loads the translation in @soPath. Throws if it cannot be loaded or
+    /// was built against another XLAT_ABI_VERSION.
+    static std::shared_ptr<const Translation> load(const char *soPath);
+
+    /// Hash identifying an image, as stored in XlatImage::imageHash.
+    static u64 imageHash(const u8 *image, const size_t len);
+
+    /// Returns true if this is a translation of @image.
+    bool matches(const std::vector<u8>& image) const;
+
+    /// Translated block starting at @offset into the image, or null.
+    XlatBlockFn blockAt(const u32 offset) const {
+        return offset < table.size() ? table[offset] : nullptr;
+    }
+
+  private:
+    explicit Translation(void *_lib, const XlatImage *_desc);
+
+    void *lib;
+    const XlatImage *desc;
+
+    /// Block function by image offset.
+    std::vector<XlatBlockFn> table;
+};
@@ -1,19 +1,73 @@
 #pragma once
 
+#include <cfenv>
 #include <cstdio>
 #include <fcntl.h>
 #include <iostream>
 #include <memory>
+#include <unordered_map>
 
 #include "auxlib/Types.h"
 
 #include "Memory.h"
+#include "Profile.h"
+#include "Translation.h"
+#include "Verifier.h"
 
+/// Why a call to Transputer::run returned.
+enum class RunStatus : u8 {
+    Halted,           // I reached the end of memory, where the program ends.
+    BudgetExhausted,  // The tick budget was used up.
+    Blocked,          // A link transfer could not complete; retried on resume.
+    Faulted,          // The program raised an error. Transputer::run throws
+                      // instead; VMHost and BatchRunner report it.
+};
+
+/// Host callbacks for the four link channels. Plain function pointers plus a
+/// context keep an idle instance small; either callback may be left null, in
+/// which case transfers on that direction block forever.
+struct LinkHandlers {
+    /// Delivers a word from the host on @link. Returns false if none is ready.
+    bool (*in)(void *ctx, u32 link, u32 &word) = nullptr;
+    /// Hands a word to the host on @link. Returns false if it cannot accept.
+    bool (*out)(void *ctx, u32 link, u32 word) = nullptr;
+    void *ctx = nullptr;
+};
+
+/// Code and data share one memory. A program image is loaded at the top of
+/// memory, so that it ends exactly where memory does; running off its end
+/// halts. The workspace starts at address 0 and grows up towards the code.
+///
+/// Instructions are fetched from memory and decoded a basic block at a time.
+/// Decoded blocks are cached by address, and the pages they were decoded
+/// from are flagged in the memory, so that any store into them - including
+/// a program loading new code over old - drops the affected blocks.
+///
+/// A verified image can instead run as native code, translated ahead of time
+/// by xlat; see attachTranslation.
+///
+/// Like the T800, I have a floating-point unit beside the integer stack: a
+/// stack of three registers FA, FB and FC, each holding a single or double
+/// length IEEE value. Its operations run on the host's IEEE arithmetic,
+/// which rounds exactly as the T800 does - correctly, to nearest by default.
+/// A rounding mode set through fpentry applies to the next operation only.
 class Transputer {
   public:
-    Transputer():
+    static constexpr u32 DEFAULT_MEM_SIZE = 1 << 16;
+
+    /// Longest run of instructions decoded into one block.
+    static constexpr u32 MAX_BLOCK_INSTRS = 64;
+
+    /// As on the T-series, link channels live at the bottom of the signed
+    /// address space: four output words followed by four input words. Word
+    /// loads and stores to these addresses become link transfers.
+    static constexpr u32 LINK_OUT_BASE = 0x80000000;
+    static constexpr u32 LINK_IN_BASE  = 0x80000010;
+    static constexpr u32 LINK_END      = 0x80000020;
+
+    Transputer(const u32 _memSize = DEFAULT_MEM_SIZE):
       hasPath(false),
-      memPtr(std::make_unique<WriteableMemory>()) {
+      memSize(_memSize) {
         reset();
     }
 
@@ -22,21 +76,69 @@ class Transputer {
         loadProgram(filePath);
     }
 
+    /// Resets the registers and memory, and reloads the program image, if
+    /// any.
     void reset() {
         tickCount = 0;
 
-        I = 0;
+        codeBase = memSize - instrBuf.size();
+
+        I = codeBase;
         W = 0;
         O = 0;
         A = 0;
         B = 0;
         C = 0;
 
-        memPtr->clearMemory();
+        FA = FB = FC = FpReg();
+        fpRound = FE_TONEAREST;
+        fpError = false;
+
+        blocks.clear();
+        pageBlocks.clear();
+
+        // Memory is only allocated once a program is loaded, so that idle
+        // instances stay a few hundred bytes large.
+        if (memPtr) {
+            memPtr->resetDirty();
+            memPtr->clearCodePages();
+            memPtr->writeBlock(codeBase, instrBuf.data(), instrBuf.size());
+
+            // The proof and any translation stand for the whole image, so a
+            // store to it has to be caught even before the page it lands on
+            // is first decoded.
+            if (imageVerified && !instrBuf.empty())
+                memPtr->markCode(codeBase, instrBuf.size());
+        }
+
+        // The image is pristine again, so its proof holds again.
+        verified = imageVerified;
+    }
+
+    /// Forgets the loaded program and clears memory.
+    void unloadProgram() {
+        instrBuf.clear();
+        hasPath = false;
+        instrPath.clear();
+        imageVerified = false;
+        translation.reset();
+        reset();
+    }
+
+    /// Allocates the emulated memory now rather than at the first load.
+    void ensureMemory() {
+        if (!memPtr) memPtr = std::make_unique<WriteableMemory>(memSize);
+    }
+
+    /// The emulated memory, for hosts that move data in and out of it
+    /// directly.
+    WriteableMemory& getMemory() {
+        ensureMemory();
+        return *memPtr;
     }
 
     void loadProgram(const char *filePath) {
-        const int fd = open(filePath.c_str(), O_RDONLY);
+        const int fd = open(filePath, O_RDONLY);
         
         struct stat st;
         int retCode = fstat(fd, &st);
@@ -55,12 +157,88 @@ class Transputer {
 
         hasPath = true;
         instrPath = std::string(filePath);
+
+        installImage();
+    }
+
+    /// Loads a program image of @len bytes from a buffer owned by the caller.
+    void loadProgram(const u8 *image, const size_t len) {
+        instrBuf.assign(image, image + len);
+
+        hasPath = false;
+        instrPath.clear();
+
+        installImage();
+    }
+
+    /// Returns true if the loaded image passed the Verifier and has not been
+    /// overwritten since, and so runs on the unchecked interpreter.
+    bool isVerified() const { return verified; }
+
+    /// Address the program image was loaded at.
+    u32 getCodeBase() const { return codeBase; }
+
+    /// Why the loaded image failed verification, if it did.
+    const std::string& getVerifyError() const { return verifyError; }
+
+    void setLinkHandlers(const LinkHandlers& handlers) {
+        links = handlers;
+    }
+
+    /// Runs the loaded image as the native code in @translated from now on,
+    /// for as long as it stays verified and unmodified. Throws if
+    /// @translated is not a translation of the loaded image. Loading another
+    /// image detaches it.
+    void attachTranslation(std::shared_ptr<const Translation> translated) {
+        if (!translated->matches(instrBuf))
+            throw BException("Cannot attach translation - it was made from "
+                             "another image.");
+
+        translation = std::move(translated);
+        reset();
+    }
+
+    /// Charges the host cost of everything run from now on to @_profile, or
+    /// stops profiling if it is null. The caller keeps ownership. Profiled
+    /// runs always use the interpreter, even with a translation attached.
+    void setProfile(Profile *_profile) {
+        profile = _profile;
     }
 
+    /// Executes at most @budget instructions. Returns early if the program
+    /// halts or blocks on a link; a blocked instruction is retried by the
+    /// next call to run.
+    RunStatus run(u64 budget) {
+        try {
+            // A verified image that overwrites its code stops being
+            // verified, and carries on with what is left of the budget on
+            // the checked interpreter.
+            if (profile) [[unlikely]] {
+                if (verified) runLoop<false, true>(budget);
+                if (!verified) runLoop<true, true>(budget);
+            } else {
+                if (verified && translation) runTranslated(budget);
+
+                if (verified) runLoop<false>(budget);
+                if (!verified) runLoop<true>(budget);
+            }
+        } catch (const LinkStall&) {
+            return RunStatus::Blocked;
+        }
+
+        return I == memSize ? RunStatus::Halted
+                            : RunStatus::BudgetExhausted;
+    }
+
+    u64 getTickCount() const { return tickCount; }
+
+    /// Executes a single instruction byte on the checked interpreter,
+    /// bypassing the block cache.
     void tick() {
-        const u8 instr = instrBuf[I];
-        doInstr(instr);
+        const u8 instr = memPtr->readByte(I);
+        doInstr<true>(instr);
         tickCount++;
+        if (memPtr->codeWritten()) dropWrittenBlocks();
     }
 
     void dumpState(bool dumpMemory = false) {
@@ -71,19 +249,55 @@ class Transputer {
                   << "O = " << O << "\n"
                   << "A = " << A << "\n"
                   << "B = " << B << "\n"
-                  << "C = " << C << "\n";
+                  << "C = " << C << "\n"
+                  << "FA = " << FA.value << (FA.single ? " (single)" : "") << "\n"
+                  << "FB = " << FB.value << (FB.single ? " (single)" : "") << "\n"
+                  << "FC = " << FC.value << (FC.single ? " (single)" : "") << "\n";
 
         if (dumpMemory) {
             std::cerr << "===== MEMORY =====\n";
-            memPtr->dumpContents();
+            if (memPtr) memPtr->dumpContents();
         }
     }
 
+    /// Shifts the @nBytes most significant bytes of @data into @crc, using
+    /// the generator polynomial @gen, as done by crcword / crcbyte.
+    static u32 crcStep(u32 crc, u32 data, const u32 gen, const int nBytes);
+
   private:
+    /// Thrown by a link transfer that cannot complete, to unwind out of the
+    /// current instruction before it commits any state.
+    struct LinkStall {};
+
     bool hasPath;
+    u32 memSize;
     std::string instrPath;    
     std::vector<u8> instrBuf;
     std::unique_ptr<WriteableMemory> memPtr;
+    LinkHandlers links;
+
+    u32 codeBase = 0;
+    bool verified = false;
+    bool imageVerified = false;
+    std::string verifyError;
+    std::vector<u32> retTargets;
+    u32 wsHigh = 0;
+
+    std::shared_ptr<const Translation> translation;
+    static const XlatServices xlatServices;
+
+    Profile *profile = nullptr;
+
+    /// A basic block, decoded from memory. Ends after a jump, call or ret,
+    /// or after MAX_BLOCK_INSTRS instructions.
+    struct Block {
+        std::vector<DecodedInstr> instrs;
+    };
+
+    /// Decoded blocks by start address, and the blocks decoded from each
+    /// page, to drop when the page is written.
+    std::unordered_map<u32, Block> blocks;
+    std::unordered_map<u32, std::vector<u32>> pageBlocks;
 
     // Registers.
     u32 I = 0;
@@ -91,10 +305,140 @@ class Transputer {
     u32 O = 0;
     u32 A, B, C = 0;
 
+    /// A floating-point register. Single length values are held widened to
+    /// double, which is exact, and narrowed again for arithmetic.
+    struct FpReg {
+        double value = 0;
+        bool single = false;
+    };
+
+    FpReg FA, FB, FC;
+    int fpRound = FE_TONEAREST;  // For the next operation, as for fesetround.
+    bool fpError = false;        // Set by results that are infinite or NaN.
+
     u64 tickCount = 0;
 
+    /// The interpreter comes in two variants. The checked one guards every
+    /// memory access and control transfer. The unchecked one runs verified
+    /// images only, and skips the guards the Verifier has discharged. The
+    /// profiled variants report to the attached Profile as they go.
+    /// Deducts what ran from @budget. The unchecked variants return as soon
+    /// as the image stops being verified.
+    template <bool Checked, bool Profiled = false>
+    void runLoop(u64& budget);
+
+    /// Runs translated blocks while the image stays verified, and deducts
+    /// what they executed from @budget.
+    void runTranslated(u64& budget);
+
+    template <bool Checked>
     void doInstr(const u8 instrCode);
+
+    /// Executes a non-prefix instruction whose last byte is at I, with its
+    /// operand already built up.
+    template <bool Checked>
+    void execute(const u8 code, const u32 oper);
+
+    /// Returns the block starting at @addr, decoding it if needed.
+    Block& blockAt(const u32 addr);
+
+    /// Drops the blocks decoded from code pages written since the last call.
+    /// The program has modified itself, so its proof no longer holds.
+    void dropWrittenBlocks();
+
+    template <bool Checked>
     void doOp(const u8 opCode);
 
+    /// Executes the floating-point operation @opCode. Its memory operands
+    /// always go through the checked readWord / writeWord.
+    void doFpOp(const u8 opCode);
+
+    /// Returns @compute(@a, @b), evaluated under the rounding mode @round.
+    template <typename T, typename F>
+    static auto fpRounded(const int round, const T a, const T b, F compute);
+
+    void fpPush(const FpReg& reg) {
+        FC = FB;
+        FB = FA;
+        FA = reg;
+    }
+
+    void fpPop() {
+        FA = FB;
+        FB = FC;
+    }
+
+    void installImage() {
+        if (instrBuf.size() > memSize)
+            throw BException("Cannot load program of %lu bytes into a memory "
+                             "of %lu bytes.", instrBuf.size(), memSize);
+
+        ensureMemory();
+
+        // The workspace may use everything below the image.
+        const u32 wsBytes = (memSize - instrBuf.size()) & ~3u;
+        VerifyResult result = Verifier::verify(instrBuf, wsBytes);
+        imageVerified = result.ok;
+        verifyError = std::move(result.error);
+        retTargets = std::move(result.retTargets);
+        wsHigh = result.wsHigh;
+        translation.reset();
+
+        reset();
+    }
+
+    /// Workspace access - proven in bounds for verified images.
+    template <bool Checked>
+    u32 readLocal(const u32 addr) {
+        if constexpr (Checked) return readWord(addr);
+        else return memPtr->readWordUnchecked(addr);
+    }
+
+    template <bool Checked>
+    void writeLocal(const u32 addr, const u32 word) {
+        if constexpr (Checked) writeWord(addr, word);
+        else memPtr->writeWordUnchecked(addr, word);
+    }
+
+    u32 readWord(const u32 addr) {
+        if (addr >= LINK_OUT_BASE && addr < LINK_END) [[unlikely]] {
+            return linkIn(addr);
+        }
+        return memPtr->readWord(addr);
+    }
+
+    void writeWord(const u32 addr, const u32 word) {
+        if (addr >= LINK_OUT_BASE && addr < LINK_END) [[unlikely]] {
+            linkOut(addr, word);
+            return;
+        }
+        memPtr->writeWord(addr, word);
+    }
+
+    u32 linkIn(const u32 addr) {
+        if (addr < LINK_IN_BASE)
+            throw BException("Attempted to read from link output channel at "
+                             "position %lu.", addr);
+
+        u32 word;
+        if (!links.in || !links.in(links.ctx, (addr - LINK_IN_BASE) >> 2, word))
+            throw LinkStall{};
+
+        return word;
+    }
+
+    void linkOut(const u32 addr, const u32 word) {
+        if (addr >= LINK_IN_BASE)
+            throw BException("Attempted to write to link input channel at "
+                             "position %lu.", addr);
+
+        if (!links.out || !links.out(links.ctx, (addr - LINK_OUT_BASE) >> 2, word))
+            throw LinkStall{};
+    }
+
     void advanceInstr() { I += 1; }
 };
+
+// Hosts keep very many idle instances around; see VMHost.
+static_assert(sizeof(Transputer) <= 512,
+              "An idle Transputer should stay a few hundred bytes large.");
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "auxlib/Types.h"
+
+#include "Transputer.h"
+
+/// Hands out pre-warmed Transputer instances for short, frequent runs.
+///
+/// All instances are built with their memory already allocated and touched,
+/// and are never freed while the pool lives. Releasing an instance resets its
+/// registers and zeroes only the pages the run dirtied, so neither acquire()
+/// nor release() goes through malloc or clears untouched memory.
+///
+/// The pool is thread-safe. On NUMA machines, create one pool per node: the
+/// instances of a pool bound to @numaNode are built on a thread pinned to
+/// that node's CPUs, so first-touch places their memory there. Workers
+/// pinned to the same node should then draw from that pool.
+class TransputerPool {
+  public:
+    static constexpr int ANY_NODE = -1;
+
+    TransputerPool(
+      const u32 capacity,
+      const u32 memSize = Transputer::DEFAULT_MEM_SIZE,
+      const int numaNode = ANY_NODE);
+
+    TransputerPool(const TransputerPool&) = delete;
+    TransputerPool& operator=(const TransputerPool&) = delete;
+
+    /// Takes an instance from the pool, building a new one if it is empty.
+    Transputer* acquire();
+
+    /// Returns an instance obtained from acquire() to the pool, detached from
+    /// its link handlers and profile.
+    void release(Transputer *vm);
+
+    /// Number of instances ready to be acquired.
+    u32 available() {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        return freeList.size();
+    }
+
+  private:
+    const u32 memSize;
+    const int numaNode;
+
+    std::mutex poolMutex;
+    std::vector<std::unique_ptr<Transputer>> allInstances;
+    std::vector<Transputer*> freeList;
+
+    /// Builds @count instances with their memory allocated, on the pool's
+    /// node if it has one.
+    void warm(const u32 count);
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "auxlib/Types.h"
+
+#include "Transputer.h"
+
+/// Opaque reference to an instance owned by a VMHost. The low half indexes
+/// the slot, the high half holds the slot's generation, so handles to
+/// destroyed instances are detected instead of silently reaching a new one.
+typedef u64 VMHandle;
+
+/// Outcome of VMHost::run.
+struct RunResult {
+    RunStatus status;
+    u64 ticks;            // Instructions executed during this call.
+    std::string error;    // Why the program faulted, if status is Faulted.
+};
+
+/// Embedding interface for hosting many emulator instances in one process.
+///
+/// Instances live in fixed-size chunks of slots which are never moved or
+/// returned to the allocator; destroyed slots go on a free list and are
+/// reused by the next create(). An instance that has not loaded a program
+/// holds no emulated memory, so a host can keep very many of them around.
+///
+/// A VMHost is not thread-safe. Hosts running instances on several threads
+/// should give each thread its own VMHost.
+class VMHost {
+  public:
+    static constexpr u32 CHUNK_SIZE = 1024;
+
+    VMHost() = default;
+    VMHost(const VMHost&) = delete;
+    VMHost& operator=(const VMHost&) = delete;
+
+    /// Creates an instance with @memSize bytes of memory.
+    VMHandle create(const u32 memSize = Transputer::DEFAULT_MEM_SIZE);
+
+    /// Destroys the instance behind @handle, releasing its memory.
+    void destroy(const VMHandle handle);
+
+    /// Loads a program image from a caller-owned buffer and resets the
+    /// instance. The buffer may be freed as soon as this returns.
+    void load(const VMHandle handle, const u8 *image, const size_t len) {
+        get(handle).loadProgram(image, len);
+    }
+
+    /// Routes the instance's link channels to host callbacks.
+    void setLinkHandlers(const VMHandle handle, const LinkHandlers& handlers) {
+        get(handle).setLinkHandlers(handlers);
+    }
+
+    /// Runs the instance for at most @budget instructions. Faults raised by
+    /// the program are reported in the result rather than thrown.
+    RunResult run(const VMHandle handle, const u64 budget);
+
+    /// Direct access to the instance, for hosts that need more than the
+    /// calls above.
+    Transputer& get(const VMHandle handle);
+
+    /// Number of live instances.
+    u32 size() const { return liveCount; }
+
+  private:
+    struct Slot {
+        std::optional<Transputer> vm;
+        u32 generation = 0;
+        u32 nextFree = 0;
+    };
+
+    static constexpr u32 NO_SLOT = ~0u;
+
+    std::vector<std::unique_ptr<Slot[]>> chunks;
+    u32 freeHead = NO_SLOT;
+    u32 slotCount = 0;
+    u32 liveCount = 0;
+
+    Slot& slotAt(const u32 idx) {
+        return chunks[idx / CHUNK_SIZE][idx % CHUNK_SIZE];
+    }
+};
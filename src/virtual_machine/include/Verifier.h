@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "auxlib/Types.h"
+
+/// One decoded instruction: its prefix bytes folded into the operand.
+struct DecodedInstr {
+    u32 start;  // Offset of the first prefix byte.
+    u32 end;    // Offset of the next instruction.
+    u8 code;    // Function code of the final byte.
+    u32 oper;   // Operand, as built up by the prefixes.
+};
+
+/// Outcome of Verifier::verify. If @ok is false, @error says why and the
+/// image must run on the checked interpreter.
+struct VerifyResult {
+    bool ok;
+    std::string error;
+
+    static constexpr u32 NOT_RET_TARGET = ~0u;
+
+    /// For each offset that follows a call, the workspace pointer a `ret`
+    /// there must leave behind; NOT_RET_TARGET elsewhere. A verified image
+    /// may only return this way, since the return address lives in memory
+    /// the program can overwrite.
+    std::vector<u32> retTargets;
+
+    /// Bytes from address 0 that ldl / stl / ldlp and call frames may touch,
+    /// given that the workspace pointer starts at 0.
+    u32 wsHigh;
+};
+
+/// Load-time proof that an image cannot misbehave in the ways the checked
+/// interpreter guards against on every instruction:
+/// |
+/// * every j / cj / call target lies in the image and on an instruction
+/// |   boundary, never inside a prefix chain;
+/// * every operation is one the VM implements;
+/// * the workspace pointer is the same on every path into an instruction,
+/// |   tracking ajw, call and ret;
+/// * each routine - the code reached from a call target - is entered at
+/// |   one workspace, and its every ret is back at that workspace;
+/// * every ldl / stl / ldlp stays within the first @wsBytes of memory.
+///
+/// Only control and workspace accesses are static. ldnl / stnl addresses and
+/// ret targets come from the stack or memory, and stay checked at run time.
+class Verifier {
+  public:
+    /// Splits @image into instructions. Returns false if it ends inside a
+    /// prefix chain.
+    static bool decode(
+      const std::vector<u8>& image,
+      std::vector<DecodedInstr>& instrs);
+
+    static VerifyResult verify(const std::vector<u8>& image, const u32 wsBytes);
+
+    /// Returns true if the VM implements the operation @opCode.
+    static bool isKnownOp(const u32 opCode);
+
+    /// Returns true if @opCode is one of the T800 floating-point operations.
+    static bool isFloatOp(const u32 opCode);
+};
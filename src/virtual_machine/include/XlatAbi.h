@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+/// Interface between the emulator and images translated to native code by
+/// xlat. The translated code is compiled on its own and loaded with dlopen,
+/// so this header is all the two share. Bump XLAT_ABI_VERSION on any change.
+#define XLAT_ABI_VERSION 1
+
+/// Name of the XlatImage a translated shared object exports.
+#define XLAT_IMAGE_SYMBOL "xlat_image"
+
+struct XlatContext;
+
+/// What translated code leaves to the emulator. All of these may throw; the
+/// caller spills its registers to the context first, with I at the start of
+/// the instruction, so that a stalled instruction is retried as a whole.
+struct XlatServices {
+    /// ldnl / stnl - bounds and link checked.
+    uint32_t (*readWord)(XlatContext *ctx, uint32_t addr);
+    void (*writeWord)(XlatContext *ctx, uint32_t addr, uint32_t word);
+
+    /// Operations not translated inline, on the registers in the context.
+    void (*operate)(XlatContext *ctx, uint32_t op);
+
+    /// Raises the fault for a ret to an address that does not follow a call
+    /// from the current workspace.
+    void (*badReturn)(XlatContext *ctx, uint32_t addr);
+};
+
+/// Registers and memory of the running instance. Translated blocks keep the
+/// registers in locals and write them back when they exit.
+struct XlatContext {
+    uint32_t I, W, A, B, C;
+    uint32_t codeBase;
+    uint8_t *mem;
+
+    /// Instructions executed by completed blocks, counting prefixes.
+    uint64_t ticks;
+
+    /// Set by the services when a store hit the image. The block then exits
+    /// after the storing instruction, as its own code may be stale.
+    uint8_t codeWritten;
+
+    const XlatServices *services;
+    void *vm;
+};
+
+typedef void (*XlatBlockFn)(XlatContext *ctx);
+
+struct XlatBlock {
+    uint32_t offset;  // Offset of the block's first instruction in the image.
+    XlatBlockFn fn;
+};
+
+/// Describes a translated image. The emulator only runs it in place of an
+/// image of the same size and hash.
+struct XlatImage {
+    uint32_t abiVersion;
+    uint32_t imageSize;
+    uint64_t imageHash;
+    uint32_t blockCount;
+    const XlatBlock *blocks;
+};
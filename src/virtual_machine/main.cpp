@@ -1,10 +1,80 @@
 #include <cassert>
 
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+
+#include "include/BatchRunner.h"
+#include "include/HostServer.h"
 #include "include/Transputer.h"
 
+ABSL_FLAG(std::string, native, "",
+          "Shared object built from the program by xlat. If the program "
+          "verifies, it then runs as native code.");
+
+ABSL_FLAG(std::string, profile, "",
+          "Profile the run with hardware counters, per \"block\" or per "
+          "\"instr\", and print the host cost per emulated instruction.");
+
+ABSL_FLAG(std::string, manifest, "",
+          "Run every job listed in this manifest and report pass/fail, "
+          "throughput and latency, instead of running a single program.");
+
+ABSL_FLAG(uint32_t, threads, 0,
+          "Worker threads for --manifest; 0 means one per core.");
+
 int main(int argc, char** argv) {
-	Chip chip;
-	chip.load(std::string(argv[2]));
+	const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+
+	const std::string manifestPath = absl::GetFlag(FLAGS_manifest);
+	if (!manifestPath.empty()) {
+		const std::vector<BatchJob> jobs = BatchRunner::parseManifest(manifestPath);
+		const BatchReport report = BatchRunner::run(jobs, absl::GetFlag(FLAGS_threads));
+		report.print(std::cout, jobs);
+		return report.failed == 0 ? 0 : 1;
+	}
+
+	if (args.size() < 2) {
+		std::cerr << "Usage: " << args[0] << " [--native=<so>] [--profile=block|instr] <program>\n"
+		          << "       " << args[0] << " --manifest=<file> [--threads=N]\n";
+		return 1;
+	}
+
+	Transputer transputer(args[1]);
+
+	const std::string nativePath = absl::GetFlag(FLAGS_native);
+	if (!nativePath.empty()) {
+		transputer.attachTranslation(Translation::load(nativePath.c_str()));
+	}
+
+	std::unique_ptr<Profile> profile;
+	const std::string profileMode = absl::GetFlag(FLAGS_profile);
+	if (profileMode == "block" || profileMode == "instr") {
+		profile = std::make_unique<Profile>(profileMode == "block"
+			? Profile::Granularity::Block : Profile::Granularity::Instruction);
+		transputer.setProfile(profile.get());
+	} else if (!profileMode.empty()) {
+		std::cerr << "--profile must be \"block\" or \"instr\".\n";
+		return 1;
+	}
+
+	// Link 0 goes to the host, for file and console I/O.
+	HostServer server;
+	HostServer::Client client(server, transputer);
+	transputer.setLinkHandlers(client.handlers());
+
+	for (;;) {
+		const RunStatus status = transputer.run(~0ull);
+		if (status == RunStatus::Halted) break;
+		if (status != RunStatus::Blocked) continue;
+
+		client.waitForReply();
+		if (!client.replyReady()) {
+			std::cerr << "Program blocked on a link with no request in flight.\n";
+			break;
+		}
+	}
+	transputer.dumpState();
+	if (profile) profile->print(std::cerr);
 
-    return 0;
+	return client.exitStatus().value_or(0);
 }
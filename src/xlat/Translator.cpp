@@ -0,0 +1,262 @@
+#include "include/Translator.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+#include "Translation.h"
+
+namespace {
+    /// Helpers shared by all generated blocks.
+    const char *PRELUDE = R"(// Generated by xlat - do not edit.
+#include <stdint.h>
+#include <string.h>
+
+#include "XlatAbi.h"
+
+// Memory is little-endian, as on the transputer.
+static inline uint32_t LD(const uint8_t *mem, uint32_t addr) {
+    uint32_t word;
+    memcpy(&word, mem + addr, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap32(word);
+#endif
+    return word;
+}
+
+static inline void ST(uint8_t *mem, uint32_t addr, uint32_t word) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap32(word);
+#endif
+    memcpy(mem + addr, &word, sizeof(word));
+}
+
+// Hands the registers back to the emulator, with I at @at.
+#define SPILL(at) \
+    (ctx->I = (at), ctx->W = W, ctx->A = A, ctx->B = B, ctx->C = C)
+
+// Leaves the block for @to, having executed @n instruction bytes.
+#define EXIT(to, n) \
+    do { SPILL(to); ctx->ticks += (n); return; } while (0)
+
+)";
+
+    void appendf(std::string& out, const char *fmt, ...) {
+        char buf[512];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        out += buf;
+    }
+
+    bool endsBlock(const DecodedInstr& instr) {
+        return instr.code == 0x9 || instr.code == 0xA || instr.code == 0xE ||
+               (instr.code == 0x2 && instr.oper == 0x20);
+    }
+}
+
+std::string Translator::translate(const std::vector<u8>& image) {
+    const u32 size = image.size();
+    if (size == 0) {
+        throw BException("Cannot translate image - it is empty.");
+    }
+
+    // The workspace size does not change the code, only whether it fits a
+    // given memory; the emulator checks that when it loads the image.
+    const VerifyResult verified = Verifier::verify(image, ~3u);
+    if (!verified.ok) {
+        throw BException("Cannot translate image - %s", verified.error.c_str());
+    }
+
+    std::vector<DecodedInstr> instrs;
+    Verifier::decode(image, instrs);
+
+    // Blocks start at the entry point, at every jump and call target, and
+    // after every instruction that transfers control.
+    std::vector<bool> leader(size + 1, false);
+    leader[0] = true;
+    for (const DecodedInstr& instr: instrs) {
+        if (instr.code == 0x9 || instr.code == 0xA || instr.code == 0xE) {
+            leader[instr.end + instr.oper] = true;
+        }
+        if (endsBlock(instr)) leader[instr.end] = true;
+    }
+
+    std::string out = PRELUDE;
+
+    out += "static const uint32_t RET_WS[] = {";
+    for (u32 offset = 0; offset <= size; ++offset) {
+        if (offset % 8 == 0) out += "\n   ";
+        appendf(out, " 0x%Xu,", verified.retTargets[offset]);
+    }
+    appendf(out, "\n};\n\n#define IMAGE_SIZE %uu\n\n", size);
+
+    // A link transfer that stalls is retried from its own first byte, so
+    // the rest of its block is needed from there as well.
+    std::vector<u32> blockStarts;
+    for (u32 first = 0; first < instrs.size(); ++first) {
+        const DecodedInstr& entry = instrs[first];
+        if (!leader[entry.start] && entry.code != 0xB && entry.code != 0xC)
+            continue;
+
+        const u32 start = entry.start;
+        blockStarts.push_back(start);
+
+        appendf(out, "static void b_%u(XlatContext *ctx) {\n", start);
+        out += "    const uint32_t base = ctx->codeBase;\n"
+               "    uint8_t *const mem = ctx->mem;\n"
+               "    uint32_t W = ctx->W, A = ctx->A, B = ctx->B, C = ctx->C;\n"
+               "    (void)mem;\n\n";
+
+        for (u32 idx = first;;) {
+            const DecodedInstr& instr = instrs[idx++];
+            const bool last = endsBlock(instr) || idx == instrs.size() ||
+                              leader[instrs[idx].start];
+
+            translateInstr(instr, last, instr.end - start, out);
+            if (last) break;
+        }
+
+        out += "}\n\n";
+    }
+
+    out += "static const XlatBlock BLOCKS[] = {\n";
+    for (const u32 start: blockStarts) {
+        appendf(out, "    {%u, b_%u},\n", start, start);
+    }
+    out += "};\n\n";
+
+    appendf(out,
+        "extern \"C\" const XlatImage xlat_image = {\n"
+        "    XLAT_ABI_VERSION, IMAGE_SIZE, 0x%016llxull, %u, BLOCKS,\n"
+        "};\n",
+        static_cast<unsigned long long>(
+            Translation::imageHash(image.data(), image.size())),
+        static_cast<u32>(blockStarts.size()));
+
+    return out;
+}
+
+void Translator::translateInstr(
+  const DecodedInstr& instr,
+  const bool last,
+  const u32 ticks,
+  std::string& out) {
+    const u32 oper = instr.oper;
+    const u32 words = oper * 4;
+    const u32 target = instr.end + oper;
+
+    appendf(out, "    /* %u */ ", instr.start);
+
+    switch (instr.code) {
+        case 0x2: // opr
+            switch (oper) {
+                case 0x0: out += "{ const uint32_t t = A; A = B; B = t; }\n"; break;
+                case 0x1: out += "A = (A == 0);\n"; break;
+                case 0x2: out += "A = (B > A); C = (B > A);\n"; break;
+                case 0x3: out += "A = A & B;\n"; break;
+                case 0x4: out += "A = A | B;\n"; break;
+                case 0x5: out += "A = A ^ B;\n"; break;
+                case 0x6: out += "A = A + B;\n"; break;
+                case 0x7: out += "A = A - B;\n"; break;
+                case 0x8: out += "A = A * B;\n"; break;
+                case 0x9:
+                case 0xA:
+                    // The emulator reports division by zero.
+                    appendf(out,
+                        "if (B == 0) {\n"
+                        "        SPILL(base + %uu);\n"
+                        "        ctx->services->operate(ctx, 0x%Xu);\n"
+                        "    }\n"
+                        "    A = A %c B;\n", instr.start, oper, oper == 0x9 ? '/' : '%');
+                    break;
+                case 0xB: out += "A <<= B;\n"; break;
+                case 0xC: out += "A >>= B;\n"; break;
+                case 0x20: // ret
+                    appendf(out,
+                        "{\n"
+                        "        const uint32_t r = LD(mem, W);\n"
+                        "        if (r - base > IMAGE_SIZE || RET_WS[r - base] != W + 16) {\n"
+                        "            SPILL(base + %uu);\n"
+                        "            ctx->services->badReturn(ctx, r);\n"
+                        "        }\n"
+                        "        W += 16;\n"
+                        "        EXIT(r, %uu);\n"
+                        "    }\n", instr.start, ticks);
+                    return;
+                default:
+                    appendf(out,
+                        "SPILL(base + %uu);\n"
+                        "    ctx->services->operate(ctx, 0x%Xu);\n"
+                        "    A = ctx->A; B = ctx->B; C = ctx->C;\n"
+                        "    if (ctx->codeWritten) EXIT(base + %uu, %uu);\n",
+                        instr.start, oper, instr.end, ticks);
+                    break;
+            }
+            break;
+        case 0x3: // ldl
+            appendf(out, "{ const uint32_t v = LD(mem, W + 0x%Xu); C = B; B = A; A = v; }\n", words);
+            break;
+        case 0x4: // stl
+            appendf(out, "ST(mem, W + 0x%Xu, A); A = B; B = C;\n", words);
+            break;
+        case 0x5: // ldlp
+            appendf(out, "C = B; B = A; A = W + 0x%Xu;\n", words);
+            break;
+        case 0x6: // ldc
+            appendf(out, "C = B; B = A; A = 0x%Xu;\n", oper);
+            break;
+        case 0x7: // adc
+            appendf(out, "A += 0x%Xu;\n", oper);
+            break;
+        case 0x8: // eqc
+            appendf(out, "A = (A == 0x%Xu);\n", oper);
+            break;
+        case 0x9: // j
+            appendf(out, "EXIT(base + %uu, %uu);\n", target, ticks);
+            return;
+        case 0xA: // cj
+            appendf(out,
+                "if (A == 0) EXIT(base + %uu, %uu);\n"
+                "    A = B; B = C;\n"
+                "    EXIT(base + %uu, %uu);\n",
+                target, ticks, instr.end, ticks);
+            return;
+        case 0xB: // ldnl
+            appendf(out,
+                "SPILL(base + %uu);\n"
+                "    A = ctx->services->readWord(ctx, A + 0x%Xu);\n",
+                instr.start, words);
+            break;
+        case 0xC: // stnl
+            appendf(out,
+                "SPILL(base + %uu);\n"
+                "    ctx->services->writeWord(ctx, A + 0x%Xu, B);\n"
+                "    A = C;\n"
+                "    if (ctx->codeWritten) EXIT(base + %uu, %uu);\n",
+                instr.start, words, instr.end, ticks);
+            break;
+        case 0xD: // ldnlp
+            appendf(out, "A += 0x%Xu;\n", words);
+            break;
+        case 0xE: // call
+            appendf(out,
+                "{\n"
+                "        const uint32_t frame = W - 16;\n"
+                "        ST(mem, frame, base + %uu);\n"
+                "        ST(mem, frame + 4, A);\n"
+                "        ST(mem, frame + 8, B);\n"
+                "        ST(mem, frame + 12, C);\n"
+                "        W = frame;\n"
+                "        A = base + %uu;\n"
+                "        EXIT(base + %uu, %uu);\n"
+                "    }\n",
+                instr.end, instr.end, target, ticks);
+            return;
+        case 0xF: // ajw
+            appendf(out, "W += 0x%Xu;\n", words);
+            break;
+    }
+
+    if (last) appendf(out, "    EXIT(base + %uu, %uu);\n", instr.end, ticks);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "auxlib/BException.h"
+#include "auxlib/Types.h"
+
+#include "Verifier.h"
+
+/// Translates a verified program image into C++ source, ahead of time.
+///
+/// Every basic block becomes a function that keeps the registers in locals
+/// and writes them back to the XlatContext when it exits. Workspace accesses,
+/// arithmetic and control flow are inlined; what needs the emulator's checks
+/// - non-local loads and stores, block operations - goes through
+/// XlatServices. Blocks can also be entered at each ldnl / stnl, where a
+/// stalled link transfer resumes. The source exports an XlatImage that
+/// indexes the blocks by image offset, for the emulator to dispatch through.
+///
+/// Build the source into a shared object with the host compiler, e.g.
+///
+///     c++ -O2 -shared -fPIC -I src/virtual_machine/include out.cpp -o out.so
+///
+/// and load it with Translation::load.
+class Translator {
+  public:
+    /// Translates @image. Throws if it is empty, or does not pass the
+    /// Verifier: the translation relies on the same proof as the unchecked
+    /// interpreter.
+    static std::string translate(const std::vector<u8>& image);
+
+  private:
+    /// Appends the C++ statements for @instr, the last one of a block if
+    /// @last is true. @ticks is the number of bytes executed by the block up
+    /// to and including @instr.
+    static void translateInstr(
+      const DecodedInstr& instr,
+      const bool last,
+      const u32 ticks,
+      std::string& out);
+};
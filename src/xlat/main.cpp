@@ -0,0 +1,33 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "absl/flags/parse.h"
+
+#include "include/Translator.h"
+
+int main(int argc, char** argv) {
+	const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+
+	if (args.size() < 3) {
+		std::cerr << "Usage: " << args[0] << " <image> <out.cpp>\n";
+		return 1;
+	}
+
+	std::ifstream in(args[1], std::ios::binary);
+	if (!in) {
+		std::cerr << "Cannot open image " << args[1] << ".\n";
+		return 1;
+	}
+	const std::vector<u8> image(std::istreambuf_iterator<char>(in), {});
+
+	const std::string source = Translator::translate(image);
+
+	std::ofstream out(args[2], std::ios::trunc);
+	if (!(out << source)) {
+		std::cerr << "Cannot write translation to " << args[2] << ".\n";
+		return 1;
+	}
+
+	return 0;
+}
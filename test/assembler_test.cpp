@@ -1,5 +1,154 @@
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
 #include "gtest/gtest.h"
 
+#include "asm.h"
+#include "VMHost.h"
+
+#include "test_util.h"
+
 TEST(BasicSuite, BasicTest) {
 	EXPECT_EQ(7 * 6, 42);
-}
\ No newline at end of file
+}
+
+namespace {
+	// Counts down from 3, then sends 42 on link 0.
+	const std::string COUNTDOWN =
+		"ldc 3\n"
+		"stl 0\n"
+		"loop:\n"
+		"  ldl 0\n"
+		"  adc -1\n"
+		"  stl 0\n"
+		"  ldl 0\n"
+		"  cj end:\n"
+		"  j loop:\n"
+		"end:\n"
+		"  ldc 42\n"
+		"  ldc -2147483648\n"
+		"  stnl 0\n";
+
+	void writeFile(const std::string& path, const std::string& contents) {
+		std::ofstream(path, std::ios::trunc) << contents;
+	}
+
+	std::vector<u8> readFile(const std::string& path) {
+		std::ifstream in(path, std::ios::binary);
+		return std::vector<u8>(std::istreambuf_iterator<char>(in), {});
+	}
+
+	/// The running test's scratch file for incremental builds, with
+	/// extension @ext.
+	std::string incPath(const std::string& ext) {
+		return tempPath(testName() + ".inc" + ext);
+	}
+
+	std::vector<u8> assembleIncremental(
+	  const std::string& source,
+	  Assembler::IncrementalStats& stats) {
+		const std::string in = incPath(".s"), out = incPath(".bin");
+		writeFile(in, source);
+		{
+			Assembler assembler(in.c_str(), out.c_str());
+			stats = assembler.runIncremental(incPath(".cache").c_str());
+		}
+		return readFile(out);
+	}
+}
+
+TEST(AssemblerSuite, EncodesPrefixes) {
+	const std::vector<u8> image = assemble(
+		"ldc 5\n"
+		"ldc 300\n"
+		"ldc -1\n"
+		"opr move\n");
+	const std::vector<u8> expected = {
+		0x65,             // ldc 5
+		0x01, 0x02, 0x6C, // pfix 1; pfix 2; ldc 0xC
+		0x10, 0x6F,       // nfix 0; ldc 0xF
+		0x04, 0x2A,       // pfix 4; opr 0xA
+	};
+	EXPECT_EQ(image, expected);
+}
+
+TEST(AssemblerSuite, AssembledProgramRuns) {
+	const std::vector<u8> image = assemble(COUNTDOWN);
+
+	Channel channel;
+	VMHost host;
+	const VMHandle vm = host.create(1024);
+	host.load(vm, image.data(), image.size());
+	host.setLinkHandlers(vm, handlersFor(channel));
+	EXPECT_TRUE(host.get(vm).isVerified()) << host.get(vm).getVerifyError();
+
+	const RunResult result = host.run(vm, 1000);
+	EXPECT_EQ(result.status, RunStatus::Halted);
+	EXPECT_EQ(result.error, "");
+	EXPECT_EQ(channel.out, std::vector<u32>{42});
+}
+
+TEST(AssemblerSuite, IncrementalMatchesFull) {
+	std::remove(incPath(".cache").c_str());
+	Assembler::IncrementalStats stats;
+
+	EXPECT_EQ(assembleIncremental(COUNTDOWN, stats), assemble(COUNTDOWN));
+	EXPECT_EQ(stats.reused, 0u);
+	EXPECT_EQ(stats.rebuilt, 3u);
+
+	EXPECT_EQ(assembleIncremental(COUNTDOWN, stats), assemble(COUNTDOWN));
+	EXPECT_EQ(stats.reused, 3u);
+	EXPECT_EQ(stats.rebuilt, 0u);
+
+	// Growing the first section moves both labels, so every jump needs
+	// re-patching although only one section is re-encoded.
+	const std::string edited = "ldc 1000\nstl 1\n" + COUNTDOWN;
+	EXPECT_EQ(assembleIncremental(edited, stats), assemble(edited));
+	EXPECT_EQ(stats.reused, 2u);
+	EXPECT_EQ(stats.rebuilt, 1u);
+}
+
+TEST(AssemblerSuite, IgnoresCorruptCache) {
+	writeFile(incPath(".cache"), "definitely not a cache");
+	Assembler::IncrementalStats stats;
+
+	EXPECT_EQ(assembleIncremental(COUNTDOWN, stats), assemble(COUNTDOWN));
+	EXPECT_EQ(stats.rebuilt, 3u);
+
+	// A well-formed header announcing more bytes, then more relocations,
+	// than the file holds.
+	for (const bool hugeRelocs: {false, true}) {
+		std::string cache;
+		auto putU32 = [&](const u32 value) {
+			for (int shift = 0; shift < 32; shift += 8) cache.push_back(value >> shift);
+		};
+
+		putU32(ObjectFormat::CACHE_MAGIC);
+		putU32(ObjectFormat::VERSION);
+		putU32(1);
+		putU32(0);                    // Empty label.
+		cache.append(sizeof(u64), 0); // Source hash.
+		cache.push_back(1);           // Falls through.
+		putU32(hugeRelocs ? 0 : 0xFFFFFFF0);
+		if (hugeRelocs) putU32(0xFFFFFFF0);
+		writeFile(incPath(".cache"), cache);
+
+		EXPECT_EQ(assembleIncremental(COUNTDOWN, stats), assemble(COUNTDOWN));
+		EXPECT_EQ(stats.rebuilt, 3u);
+	}
+}
+
+TEST(AssemblerSuite, ReportsJumpToRemovedLabel) {
+	std::remove(incPath(".cache").c_str());
+	Assembler::IncrementalStats stats;
+	assembleIncremental("j done:\nnext:\n  ldc 1\ndone:\n  ldc 2\n", stats);
+
+	// The jump's section is unchanged, so it comes from the cache.
+	try {
+		assembleIncremental("j done:\nnext:\n  ldc 1\n", stats);
+		FAIL() << "Expected the missing label to be reported.";
+	} catch (const BException& e) {
+		EXPECT_NE(e.msg.find("done:"), std::string::npos) << e.msg;
+	}
+}
@@ -0,0 +1,132 @@
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+#include "BatchRunner.h"
+
+#include "test_util.h"
+
+namespace {
+	// Reads a word on link 0 and sends back twice it.
+	const std::string DOUBLER =
+		"ldc -2147483632\n"
+		"ldnl 0\n"
+		"stl 0\n"
+		"ldl 0\n"
+		"ldl 0\n"
+		"opr add\n"
+		"ldc -2147483648\n"
+		"stnl 0\n";
+
+	const std::string SPIN =
+		"loop:\n"
+		"  j loop:\n";
+
+	/// A scratch file for @name, private to the running test.
+	std::string scratch(const std::string& name) {
+		return testName() + "." + name;
+	}
+
+	BatchJob job(const std::string& image, std::vector<u32> input, std::vector<u32> expected) {
+		BatchJob job;
+		job.image = image;
+		job.input = std::move(input);
+		job.expected = std::move(expected);
+		job.checkOutput = true;
+		return job;
+	}
+}
+
+TEST(BatchRunnerSuite, ReportsPassAndFailInOrder) {
+	const std::string doubler = assembleFile(scratch("doubler"), DOUBLER);
+	const std::string spin = assembleFile(scratch("spin"), SPIN);
+
+	std::vector<BatchJob> jobs = {
+		job(doubler, {21}, {42}),
+		job(doubler, {5}, {11}),
+		job(doubler, {}, {}),
+		job(spin, {}, {}),
+		job(tempPath(scratch("missing.bin")), {}, {}),
+	};
+	jobs[3].budget = 1000;
+
+	const BatchReport report = BatchRunner::run(jobs, 3);
+
+	ASSERT_EQ(report.results.size(), jobs.size());
+	EXPECT_EQ(report.passed, 1u);
+	EXPECT_EQ(report.failed, 4u);
+
+	EXPECT_TRUE(report.results[0].passed);
+	EXPECT_EQ(report.results[0].output, std::vector<u32>{42});
+
+	EXPECT_FALSE(report.results[1].passed);
+	EXPECT_EQ(report.results[1].output, std::vector<u32>{10});
+
+	EXPECT_FALSE(report.results[2].passed);
+	EXPECT_EQ(report.results[2].status, RunStatus::Blocked);
+
+	EXPECT_FALSE(report.results[3].passed);
+	EXPECT_EQ(report.results[3].status, RunStatus::BudgetExhausted);
+	EXPECT_EQ(report.results[3].ticks, 1000u);
+
+	EXPECT_FALSE(report.results[4].passed);
+	EXPECT_EQ(report.results[4].status, RunStatus::Faulted);
+	EXPECT_FALSE(report.results[4].error.empty());
+}
+
+TEST(BatchRunnerSuite, ReusesWorkersAcrossJobs) {
+	const std::string doubler = assembleFile(scratch("doubler"), DOUBLER);
+
+	// More jobs than workers, and memory sizes that change between jobs.
+	std::vector<BatchJob> jobs;
+	for (u32 i = 0; i < 64; ++i) {
+		jobs.push_back(job(doubler, {i}, {2 * i}));
+		jobs.back().memSize = i % 3 == 0 ? 4096 : Transputer::DEFAULT_MEM_SIZE;
+	}
+
+	const BatchReport report = BatchRunner::run(jobs, 4);
+
+	EXPECT_EQ(report.passed, 64u);
+	EXPECT_EQ(report.failed, 0u);
+	EXPECT_EQ(report.ticks, 64 * report.results[0].ticks);
+	EXPECT_LE(report.latencyPercentile(50), report.latencyPercentile(90));
+	EXPECT_LE(report.latencyPercentile(90), report.latencyPercentile(99));
+	EXPECT_LE(report.latencyPercentile(99), report.latencyPercentile(100));
+}
+
+TEST(BatchRunnerSuite, ParsesManifests) {
+	const std::string path = tempPath(scratch("manifest"));
+	std::ofstream(path, std::ios::trunc) <<
+		"# image  options\n"
+		"\n"
+		"sum.bin in=1,2,-3 out=0x10 budget=500\n"
+		"/abs/big.bin mem=1048576\n";
+
+	const std::vector<BatchJob> jobs = BatchRunner::parseManifest(path);
+	ASSERT_EQ(jobs.size(), 2u);
+
+	EXPECT_EQ(jobs[0].image, path.substr(0, path.rfind('/') + 1) + "sum.bin");
+	EXPECT_EQ(jobs[0].input, (std::vector<u32>{1, 2, static_cast<u32>(-3)}));
+	EXPECT_EQ(jobs[0].expected, std::vector<u32>{16});
+	EXPECT_TRUE(jobs[0].checkOutput);
+	EXPECT_EQ(jobs[0].budget, 500u);
+
+	EXPECT_EQ(jobs[1].image, "/abs/big.bin");
+	EXPECT_EQ(jobs[1].memSize, 1048576u);
+	EXPECT_FALSE(jobs[1].checkOutput);
+
+	std::ofstream(path, std::ios::trunc) << "sum.bin budget=lots\n";
+	EXPECT_THROW(BatchRunner::parseManifest(path), BException);
+
+	std::ofstream(path, std::ios::trunc) << "sum.bin colour=blue\n";
+	EXPECT_THROW(BatchRunner::parseManifest(path), BException);
+
+	// Memory has to fit below the link addresses.
+	for (const char *mem: {"0", "0x80000001", "0x100000000"}) {
+		std::ofstream(path, std::ios::trunc) << "sum.bin mem=" << mem << "\n";
+		EXPECT_THROW(BatchRunner::parseManifest(path), BException) << mem;
+	}
+
+	std::ofstream(path, std::ios::trunc) << "sum.bin mem=0x80000000\n";
+	EXPECT_EQ(BatchRunner::parseManifest(path)[0].memSize, Transputer::LINK_OUT_BASE);
+}
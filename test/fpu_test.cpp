@@ -0,0 +1,257 @@
+#include "gtest/gtest.h"
+
+#include "Transputer.h"
+
+#include "test_util.h"
+
+// Conformance of the floating-point unit with the T800, which rounds as
+// IEEE 754 prescribes. Expected results are bit patterns, worked out for
+// each rounding mode.
+namespace {
+	// fpentry operations.
+	constexpr u32 FPUSQRTFIRST = 0x01;
+	constexpr u32 FPUSQRTSTEP  = 0x02;
+	constexpr u32 FPUSQRTLAST  = 0x03;
+	constexpr u32 FPURP        = 0x04;
+	constexpr u32 FPURM        = 0x05;
+	constexpr u32 FPURZ        = 0x06;
+	constexpr u32 FPUR32TOR64  = 0x07;
+	constexpr u32 FPUR64TOR32  = 0x08;
+	constexpr u32 FPUABS       = 0x0B;
+	constexpr u32 FPUDIVBY2    = 0x11;
+	constexpr u32 FPURN        = 0x22;
+
+	const std::string OUT = "ldc -2147483648\nstnl 0\n";
+
+	std::string ldc(const u32 value) {
+		return "ldc " + std::to_string(static_cast<int32_t>(value)) + "\n";
+	}
+
+	/// Puts @value in workspace word @slot.
+	std::string word(const u32 slot, const u32 value) {
+		return ldc(value) + "stl " + std::to_string(slot) + "\n";
+	}
+
+	/// Puts @bits in workspace words @slot and @slot + 1.
+	std::string dword(const u32 slot, const u64 bits) {
+		return word(slot, static_cast<u32>(bits)) + word(slot + 1, static_cast<u32>(bits >> 32));
+	}
+
+	std::string op(const std::string& name) {
+		return "opr " + name + "\n";
+	}
+
+	std::string load(const std::string& name, const u32 slot) {
+		return "ldlp " + std::to_string(slot) + "\n" + op(name);
+	}
+
+	std::string entry(const u32 operation) {
+		return ldc(operation) + op("fpentry");
+	}
+
+	/// Sends FA as a single, through workspace word 30.
+	const std::string SEND_SINGLE = load("fpstnlsn", 30) + "ldl 30\n" + OUT;
+
+	/// Sends FA as a double, low word first.
+	const std::string SEND_DOUBLE = load("fpstnldb", 30) + "ldl 30\n" + OUT + "ldl 31\n" + OUT;
+
+	/// Sends FA rounded to an integer value, as an integer.
+	const std::string SEND_INT = op("fpint") + load("fpstnli32", 30) + "ldl 30\n" + OUT;
+
+	struct Outcome {
+		std::vector<u32> out;
+		bool verified = false;
+	};
+
+	Outcome run(const std::string& source) {
+		const std::vector<u8> image = assemble(source);
+
+		Outcome result;
+		Channel channel;
+
+		Transputer vm;
+		vm.loadProgram(image.data(), image.size());
+		vm.setLinkHandlers(handlersFor(channel));
+		result.verified = vm.isVerified();
+		EXPECT_EQ(vm.run(100000), RunStatus::Halted);
+		result.out = channel.out;
+		return result;
+	}
+
+	struct RoundingCase {
+		u32 mode;
+		std::vector<u32> expected;
+	};
+}
+
+TEST(FPUSuite, DividesSinglesInEveryMode) {
+	const std::vector<RoundingCase> cases = {
+		{FPURN, {0x3EAAAAAB, 0xBEAAAAAB}},
+		{FPURZ, {0x3EAAAAAA, 0xBEAAAAAA}},
+		{FPURM, {0x3EAAAAAA, 0xBEAAAAAB}},
+		{FPURP, {0x3EAAAAAB, 0xBEAAAAAA}},
+	};
+
+	for (const RoundingCase& c: cases) {
+		// 1.0 / 3.0 and -1.0 / 3.0.
+		const std::string source =
+			word(0, 0x3F800000) + word(1, 0x40400000) + word(2, 0xBF800000) +
+			load("fpldnlsn", 0) + load("fpldnlsn", 1) + entry(c.mode) + op("fpdiv") + SEND_SINGLE +
+			load("fpldnlsn", 2) + load("fpldnlsn", 1) + entry(c.mode) + op("fpdiv") + SEND_SINGLE;
+
+		const Outcome result = run(source);
+		EXPECT_TRUE(result.verified);
+		EXPECT_EQ(result.out, c.expected) << "mode " << c.mode;
+	}
+}
+
+TEST(FPUSuite, AddsDoublesInEveryMode) {
+	const std::vector<RoundingCase> cases = {
+		{FPURN, {0x33333334, 0x3FD33333}},
+		{FPURZ, {0x33333333, 0x3FD33333}},
+		{FPURM, {0x33333333, 0x3FD33333}},
+		{FPURP, {0x33333334, 0x3FD33333}},
+	};
+
+	for (const RoundingCase& c: cases) {
+		// 0.1 + 0.2.
+		const std::string source =
+			dword(0, 0x3FB999999999999A) + dword(2, 0x3FC999999999999A) +
+			load("fpldnldb", 0) + load("fpldnldb", 2) + entry(c.mode) + op("fpadd") + SEND_DOUBLE;
+
+		EXPECT_EQ(run(source).out, c.expected) << "mode " << c.mode;
+	}
+}
+
+TEST(FPUSuite, RoundingModeLastsOneOperation) {
+	// 1.0 / 3.0 towards zero, then again to nearest. A load in between
+	// uses the mode up as well.
+	const std::string source =
+		word(0, 0x3F800000) + word(1, 0x40400000) +
+		load("fpldnlsn", 0) + load("fpldnlsn", 1) + entry(FPURZ) + op("fpdiv") + SEND_SINGLE +
+		load("fpldnlsn", 0) + load("fpldnlsn", 1) + op("fpdiv") + SEND_SINGLE +
+		load("fpldnlsn", 0) + entry(FPURZ) + load("fpldnlsn", 1) + op("fpdiv") + SEND_SINGLE;
+
+	EXPECT_EQ(run(source).out, (std::vector<u32>{0x3EAAAAAA, 0x3EAAAAAB, 0x3EAAAAAB}));
+}
+
+TEST(FPUSuite, SinglesRoundToSinglePrecision) {
+	// 2^24 + 1 is not a single, but is a double.
+	const std::string source =
+		word(0, 16777216) + word(1, 1) +
+		load("fpi32tor32", 0) + load("fpi32tor32", 1) + op("fpadd") + SEND_SINGLE +
+		load("fpi32tor64", 0) + load("fpi32tor64", 1) + op("fpadd") + SEND_DOUBLE;
+
+	EXPECT_EQ(run(source).out, (std::vector<u32>{0x4B800000, 0x10000000, 0x41700000}));
+}
+
+TEST(FPUSuite, HandlesDenormals) {
+	// The smallest denormal halved ties to zero when rounding to nearest,
+	// and the smallest normal halves exactly.
+	const std::string source =
+		word(0, 0x00000001) + word(1, 0x3F000000) + word(2, 0x00800000) +
+		load("fpldnlsn", 0) + load("fpldnlsn", 1) + op("fpmul") + SEND_SINGLE +
+		load("fpldnlsn", 0) + load("fpldnlsn", 1) + entry(FPURP) + op("fpmul") + SEND_SINGLE +
+		load("fpldnlsn", 2) + entry(FPUDIVBY2) + SEND_SINGLE;
+
+	EXPECT_EQ(run(source).out, (std::vector<u32>{0x00000000, 0x00000001, 0x00400000}));
+}
+
+TEST(FPUSuite, OverflowSetsError) {
+	// The largest single doubled overflows; fptesterr reports it once.
+	const std::string source =
+		word(0, 0x7F7FFFFF) + word(1, 0x40000000) +
+		op("fptesterr") + OUT +
+		load("fpldnlsn", 0) + load("fpldnlsn", 1) + op("fpmul") + SEND_SINGLE +
+		op("fptesterr") + OUT +
+		op("fptesterr") + OUT +
+		// Towards zero, the overflow stops at the largest single.
+		load("fpldnlsn", 0) + load("fpldnlsn", 1) + entry(FPURZ) + op("fpmul") + SEND_SINGLE;
+
+	EXPECT_EQ(run(source).out, (std::vector<u32>{1, 0x7F800000, 0, 1, 0x7F7FFFFF}));
+}
+
+TEST(FPUSuite, NarrowingStoreOverflowSetsError) {
+	// 1e300 does not fit a single; 1/3 does, if inexactly.
+	const std::string source =
+		dword(0, 0x7E37E43C8800759C) + dword(2, 0x3FD5555555555555) +
+		load("fpldnldb", 0) + SEND_SINGLE + op("fptesterr") + OUT +
+		load("fpldnldb", 2) + SEND_SINGLE + op("fptesterr") + OUT;
+
+	EXPECT_EQ(run(source).out, (std::vector<u32>{0x7F800000, 0, 0x3EAAAAAB, 1}));
+}
+
+TEST(FPUSuite, RejectsUnknownEntries) {
+	// fpuchki32, fpuchki64, fpunoround, fpuexpinc32 and fpuexpdec32 are not
+	// implemented, and must not pass for no-ops.
+	for (const u32 operation: {0x0Eu, 0x0Fu, 0x0Du, 0x0Au, 0x09u}) {
+		const std::vector<u8> image = assemble(entry(operation));
+		Transputer vm;
+		vm.loadProgram(image.data(), image.size());
+		EXPECT_THROW(vm.run(100), BException) << "entry " << operation;
+	}
+}
+
+TEST(FPUSuite, RoundsToIntegers) {
+	// 2.5, 3.5 and -2.5.
+	const std::string source =
+		word(0, 0x40200000) + word(1, 0x40600000) + word(2, 0xC0200000) +
+		load("fpldnlsn", 0) + SEND_INT +
+		load("fpldnlsn", 1) + SEND_INT +
+		load("fpldnlsn", 2) + SEND_INT +
+		load("fpldnlsn", 0) + entry(FPURP) + SEND_INT +
+		load("fpldnlsn", 2) + entry(FPURZ) + SEND_INT +
+		load("fpldnlsn", 2) + entry(FPURM) + SEND_INT;
+
+	EXPECT_EQ(run(source).out, (std::vector<u32>{2, 4, static_cast<u32>(-2), 3,
+		static_cast<u32>(-2), static_cast<u32>(-3)}));
+}
+
+TEST(FPUSuite, ConvertsAndTakesSquareRoots) {
+	const std::string sqrt =
+		entry(FPUSQRTFIRST) + entry(FPUSQRTSTEP) + entry(FPUSQRTSTEP);
+	const std::string source =
+		dword(0, 0x3FD5555555555555) + word(2, 16777217) + dword(3, 0x4000000000000000) +
+		// The double nearest 1/3, narrowed.
+		load("fpldnldb", 0) + entry(FPUR64TOR32) + SEND_SINGLE +
+		load("fpldnldb", 0) + entry(FPURZ) + entry(FPUR64TOR32) + SEND_SINGLE +
+		// 2^24 + 1 as a single.
+		load("fpi32tor32", 2) + SEND_SINGLE +
+		entry(FPURP) + load("fpi32tor32", 2) + SEND_SINGLE +
+		// Square roots of 2.
+		load("fpldnldb", 3) + sqrt + entry(FPUSQRTLAST) + SEND_DOUBLE +
+		load("fpldnldb", 3) + sqrt + entry(FPURZ) + entry(FPUSQRTLAST) + SEND_DOUBLE +
+		// Widening is exact.
+		word(5, 0xBEAAAAAB) + load("fpldnlsn", 5) + entry(FPUR32TOR64) + entry(FPUABS) + SEND_DOUBLE;
+
+	EXPECT_EQ(run(source).out, (std::vector<u32>{
+		0x3EAAAAAB, 0x3EAAAAAA,
+		0x4B800000, 0x4B800001,
+		0x667F3BCD, 0x3FF6A09E,
+		0x667F3BCC, 0x3FF6A09E,
+		0x60000000, 0x3FD55555}));
+}
+
+TEST(FPUSuite, ComparesAndShufflesTheStack) {
+	// 1.5, 2.0, and the array [0.5, 4.0].
+	const std::string source =
+		word(0, 0x3FC00000) + word(1, 0x40000000) + word(2, 0x3F000000) + word(3, 0x40800000) +
+		// 1.5 > 2.0, 2.0 > 1.5, 2.0 = 2.0.
+		load("fpldnlsn", 0) + load("fpldnlsn", 1) + op("fpgt") + OUT +
+		load("fpldnlsn", 1) + load("fpldnlsn", 0) + op("fpgt") + OUT +
+		load("fpldnlsn", 1) + op("fpdup") + op("fpeq") + OUT +
+		// 2.0 - 1.5, reversed to 1.5 - 2.0.
+		load("fpldnlsn", 1) + load("fpldnlsn", 0) + op("fprev") + op("fpsub") + SEND_SINGLE +
+		// (1.5 + [0.5, 4.0][1]) * 0.5.
+		load("fpldnlsn", 0) + ldc(1) + "ldlp 2\n" + op("fpldnlsni") +
+		op("fpadd") + load("fpldnlmulsn", 2) + SEND_SINGLE +
+		// 0.0 + 2.0.
+		op("fpldzerosn") + load("fpldnladdsn", 1) + SEND_SINGLE +
+		// Loads leave the integer stack below their address.
+		ldc(7) + load("fpldnlsn", 0) + op("fpldzerosn") + op("fpadd") + SEND_SINGLE + OUT;
+
+	const Outcome result = run(source);
+	EXPECT_TRUE(result.verified);
+	EXPECT_EQ(result.out, (std::vector<u32>{0, 1, 1, 0xBF000000, 0x40300000, 0x40000000,
+		0x3FC00000, 7}));
+}
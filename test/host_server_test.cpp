@@ -0,0 +1,210 @@
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "HostServer.h"
+
+#include "test_util.h"
+
+namespace {
+	/// Sends @word to the host.
+	std::string send(const std::string& word) {
+		return "ldc " + word + "\nldc -2147483648\nstnl 0\n";
+	}
+
+	/// Sends local @slot to the host.
+	std::string sendLocal(const int slot) {
+		return "ldl " + std::to_string(slot) + "\nldc -2147483648\nstnl 0\n";
+	}
+
+	/// Stores the next word from the host in local @slot.
+	std::string receive(const int slot) {
+		return "ldc -2147483632\nldnl 0\nstl " + std::to_string(slot) + "\n";
+	}
+
+	void runToHalt(Transputer& vm, HostServer::Client& client) {
+		for (int i = 0; i < 1000; ++i) {
+			const RunStatus status = vm.run(100000);
+			if (status == RunStatus::Halted) return;
+			if (status == RunStatus::Blocked) client.waitForReply();
+		}
+		FAIL() << "Program did not halt.";
+	}
+
+	u32 local(Transputer& vm, const u32 slot) {
+		return vm.getMemory().readWord(slot * 4);
+	}
+}
+
+TEST(HostServerSuite, WritesToConsole) {
+	int pipeFds[2];
+	ASSERT_EQ(pipe(pipeFds), 0);
+
+	const std::vector<u8> image = assemble(
+		"ldc 1819043176\nstl 0\n"  // "hell"
+		"ldc 2671\nstl 1\n"        // "o\n"
+		"ldlp 0\nstl 4\n" +
+		send("13") + send("1") + sendLocal(4) + send("6") +
+		receive(2) + receive(3));
+
+	{
+		HostServer server(0, pipeFds[1], 2);
+		Transputer vm(1024);
+		vm.loadProgram(image.data(), image.size());
+
+		HostServer::Client client(server, vm);
+		vm.setLinkHandlers(client.handlers());
+		runToHalt(vm, client);
+
+		EXPECT_EQ(local(vm, 2), HostServer::SP_SUCCESS);
+		EXPECT_EQ(local(vm, 3), 6u);
+	}
+
+	close(pipeFds[1]);
+	char buf[16] = {0};
+	EXPECT_EQ(read(pipeFds[0], buf, sizeof(buf)), 6);
+	EXPECT_STREQ(buf, "hello\n");
+	close(pipeFds[0]);
+}
+
+TEST(HostServerSuite, ReadsFilesIntoMemory) {
+	const std::string path = tempPath("input.txt");
+	std::ofstream(path, std::ios::trunc) << "abcdefgh12345678";
+
+	// open; read 16 bytes to 2048; seek to 4; tell; close; exit 3
+	const std::vector<u8> image = assemble(
+		send("10") + send("1024") + send(std::to_string(path.size())) + send("0") +
+		receive(0) + receive(1) +
+		send("12") + sendLocal(1) + send("2048") + send("16") +
+		receive(2) + receive(3) +
+		send("17") + sendLocal(1) + send("4") + send("0") +
+		receive(4) +
+		send("18") + sendLocal(1) +
+		receive(5) + receive(6) +
+		send("11") + sendLocal(1) +
+		receive(7) +
+		send("35") + send("3") +
+		receive(8));
+
+	HostServer server;
+	Transputer vm(4096);
+	vm.loadProgram(image.data(), image.size());
+	vm.getMemory().writeBlock(1024, reinterpret_cast<const u8*>(path.data()), path.size());
+
+	HostServer::Client client(server, vm);
+	vm.setLinkHandlers(client.handlers());
+	runToHalt(vm, client);
+
+	EXPECT_EQ(local(vm, 0), HostServer::SP_SUCCESS);
+	EXPECT_EQ(local(vm, 1), 3u);  // First stream after the console.
+	EXPECT_EQ(local(vm, 2), HostServer::SP_SUCCESS);
+	EXPECT_EQ(local(vm, 3), 16u);
+	EXPECT_EQ(local(vm, 4), HostServer::SP_SUCCESS);
+	EXPECT_EQ(local(vm, 5), HostServer::SP_SUCCESS);
+	EXPECT_EQ(local(vm, 6), 4u);
+	EXPECT_EQ(local(vm, 7), HostServer::SP_SUCCESS);
+	EXPECT_EQ(local(vm, 8), HostServer::SP_SUCCESS);
+	EXPECT_EQ(client.exitStatus(), std::optional<u32>(3));
+
+	const u8 *data = vm.getMemory().blockPtr(2048, 16);
+	EXPECT_EQ(std::string(data, data + 16), "abcdefgh12345678");
+
+	// The read went straight into memory, but is still accounted for, so a
+	// reset clears it.
+	EXPECT_TRUE(vm.getMemory().isDirty(2048));
+	vm.reset();
+	EXPECT_EQ(vm.getMemory().readWord(2048), 0u);
+}
+
+TEST(HostServerSuite, ResetClearsReadsNotCollected) {
+	const std::string path = tempPath("uncollected.txt");
+	std::ofstream(path, std::ios::trunc) << "abcdefgh12345678";
+
+	// open; read 16 bytes to 2048, and halt without taking the reply.
+	const std::vector<u8> image = assemble(
+		send("10") + send("1024") + send(std::to_string(path.size())) + send("0") +
+		receive(0) + receive(1) +
+		send("12") + sendLocal(1) + send("2048") + send("16"));
+
+	HostServer server;
+	Transputer vm(4096);
+	vm.loadProgram(image.data(), image.size());
+	vm.getMemory().writeBlock(1024, reinterpret_cast<const u8*>(path.data()), path.size());
+
+	HostServer::Client client(server, vm);
+	vm.setLinkHandlers(client.handlers());
+	runToHalt(vm, client);
+
+	client.reset();
+	EXPECT_FALSE(client.replyReady());
+	EXPECT_TRUE(vm.getMemory().isDirty(2048));
+
+	// The next program on this instance does not see the file's data.
+	vm.reset();
+	EXPECT_EQ(vm.getMemory().readWord(2048), 0u);
+	EXPECT_EQ(vm.getMemory().readWord(2060), 0u);
+}
+
+TEST(HostServerSuite, RejectsReadsIntoTheImage) {
+	// read 4 bytes from the console into the last word of memory, which
+	// holds the end of the program.
+	const std::vector<u8> image = assemble(
+		send("12") + send("0") + send("4092") + send("4") +
+		receive(0) + receive(1));
+
+	HostServer server;
+	Transputer vm(4096);
+	vm.loadProgram(image.data(), image.size());
+	ASSERT_TRUE(vm.isVerified());
+	const u32 lastWord = vm.getMemory().readWord(4092);
+
+	HostServer::Client client(server, vm);
+	vm.setLinkHandlers(client.handlers());
+	EXPECT_THROW(vm.run(100000), BException);
+
+	client.reset();
+	EXPECT_EQ(vm.getMemory().readWord(4092), lastWord);
+	EXPECT_TRUE(vm.isVerified());
+}
+
+TEST(HostServerSuite, WritesFilesAndReportsErrors) {
+	const std::string path = tempPath("output.txt");
+	const std::string missing = tempPath("missing/file");
+
+	// open for writing; write 8 bytes from 2048; close; open a missing file;
+	// send an unknown request
+	const std::vector<u8> image = assemble(
+		send("10") + send("1024") + send(std::to_string(path.size())) + send("1") +
+		receive(0) + receive(1) +
+		send("13") + sendLocal(1) + send("2048") + send("8") +
+		receive(2) + receive(3) +
+		send("11") + sendLocal(1) +
+		receive(4) +
+		send("10") + send("1536") + send(std::to_string(missing.size())) + send("0") +
+		receive(5) + receive(6) +
+		send("99") +
+		receive(7));
+
+	HostServer server;
+	Transputer vm(4096);
+	vm.loadProgram(image.data(), image.size());
+	vm.getMemory().writeBlock(1024, reinterpret_cast<const u8*>(path.data()), path.size());
+	vm.getMemory().writeBlock(1536, reinterpret_cast<const u8*>(missing.data()), missing.size());
+	vm.getMemory().writeBlock(2048, reinterpret_cast<const u8*>("occam!\n\n"), 8);
+
+	HostServer::Client client(server, vm);
+	vm.setLinkHandlers(client.handlers());
+	runToHalt(vm, client);
+
+	EXPECT_EQ(local(vm, 0), HostServer::SP_SUCCESS);
+	EXPECT_EQ(local(vm, 2), HostServer::SP_SUCCESS);
+	EXPECT_EQ(local(vm, 3), 8u);
+	EXPECT_EQ(local(vm, 4), HostServer::SP_SUCCESS);
+	EXPECT_EQ(local(vm, 5), HostServer::SP_ERROR);
+	EXPECT_EQ(local(vm, 7), HostServer::SP_UNIMPLEMENTED);
+
+	std::ifstream written(path);
+	EXPECT_EQ(std::string(std::istreambuf_iterator<char>(written), {}), "occam!\n\n");
+}
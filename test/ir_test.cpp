@@ -0,0 +1,386 @@
+#include "gtest/gtest.h"
+
+#include "codegen.h"
+#include "optimize.h"
+#include "Transputer.h"
+
+#include "test_util.h"
+
+using namespace ir;
+
+namespace {
+	struct Result {
+		std::vector<u32> out;
+		u64 ticks = 0;
+		std::string code;
+	};
+
+	Result compileAndRun(const Program& program) {
+		Result result;
+		result.code = CodeGen(program).generate();
+
+		const std::vector<u8> image = assemble(result.code);
+
+		Channel channel;
+		Transputer vm;
+		vm.loadProgram(image.data(), image.size());
+		vm.setLinkHandlers(handlersFor(channel));
+		EXPECT_EQ(vm.run(10000000), RunStatus::Halted) << result.code;
+		result.out = channel.out;
+		result.ticks = vm.getTickCount();
+		return result;
+	}
+
+	/// Runs @build's program as it is and optimized; both must send the
+	/// same words. Returns the optimized run.
+	template <typename Build>
+	Result compareOptimized(Build build, OptimizeStats *stats = nullptr,
+			Result *plain = nullptr) {
+		Program original = build();
+		const Result before = compileAndRun(original);
+
+		Program optimized = build();
+		Optimizer optimizer(optimized);
+		const OptimizeStats& got = optimizer.run();
+		if (stats) *stats = got;
+
+		const Result after = compileAndRun(optimized);
+		EXPECT_EQ(after.out, before.out) << toString(*optimized.main);
+		EXPECT_LE(after.ticks, before.ticks);
+		if (plain) *plain = before;
+		return after;
+	}
+
+	size_t count(const std::string& code, const std::string& instr) {
+		size_t n = 0;
+		for (size_t at = code.find(instr); at != std::string::npos; at = code.find(instr, at + 1)) {
+			if (at == 0 || code[at - 1] == '\n') ++n;
+		}
+		return n;
+	}
+
+	// PROC scale (VAL INT k, INT x)
+	//   x := x * k
+	// PROC sum ([]INT a, VAL INT n, INT total)
+	//   SEQ
+	//     total := 0
+	//     SEQ i = 0 FOR n
+	//       total := total + a[i]
+	void addProcs(Program& program) {
+		program.procs.push_back({"scale",
+			{{"k", Param::Mode::Val}, {"x", Param::Mode::Var}},
+			assign("x", bin(BinOp::Mul, var("x"), var("k")))});
+		program.procs.push_back({"sum",
+			{{"a", Param::Mode::Array}, {"n", Param::Mode::Val}, {"total", Param::Mode::Var}},
+			seq(
+				assign("total", lit(0)),
+				seqFor("i", lit(0), var("n"),
+					assign("total", bin(BinOp::Add, var("total"), elem("a", var("i"))))))});
+	}
+}
+
+TEST(IRSuite, GeneratesWorkingCode) {
+	// [4]INT a:
+	// INT x, total:
+	// SEQ
+	//   SEQ i = 0 FOR 4
+	//     a[i] := i * 3
+	//   x := 5
+	//   scale (2, x)
+	//   sum (a, 4, total)
+	//   out ! x
+	//   out ! total
+	//   IF
+	//     x > total
+	//       out ! 1
+	//     TRUE
+	//       out ! 0
+	Program program;
+	addProcs(program);
+	program.main = declArray("a", 4, decl("x", decl("total", seq(
+		seqFor("i", lit(0), lit(4), assignElem("a", var("i"), bin(BinOp::Mul, var("i"), lit(3)))),
+		assign("x", lit(5)),
+		call("scale", lit(2), var("x")),
+		call("sum", var("a"), lit(4), var("total")),
+		output(var("x")),
+		output(var("total")),
+		ifs(bin(BinOp::Gt, var("x"), var("total")), output(lit(1)),
+			lit(1), output(lit(0)))))));
+
+	const Result result = compileAndRun(program);
+	EXPECT_EQ(result.out, (std::vector<u32>{10, 18, 0}));
+}
+
+TEST(IRSuite, StopFaults) {
+	// SEQ
+	//   out ! 1
+	//   STOP, or an IF none of whose guards holds
+	//   out ! 3
+	for (const bool viaIf: {false, true}) {
+		Program program;
+		program.main = seq(
+			output(lit(1)),
+			viaIf ? ifs(bin(BinOp::Eq, lit(1), lit(2)), output(lit(2))) : stop(),
+			output(lit(3)));
+
+		const std::string code = CodeGen(program).generate();
+		const std::vector<u8> image = assemble(code);
+
+		Channel channel;
+		Transputer vm;
+		vm.loadProgram(image.data(), image.size());
+		vm.setLinkHandlers(handlersFor(channel));
+		EXPECT_THROW(vm.run(1000), BException) << code;
+		EXPECT_EQ(channel.out, std::vector<u32>{1});
+	}
+}
+
+TEST(IRSuite, InliningRemovesCalls) {
+	auto build = [] {
+		Program program;
+		addProcs(program);
+		program.main = decl("x", seq(
+			assign("x", lit(7)),
+			seqFor("i", lit(0), lit(100), seq(
+				call("scale", lit(3), var("x")),
+				assign("x", bin(BinOp::BitAnd, var("x"), lit(0xFFFF))))),
+			output(var("x"))));
+		return program;
+	};
+
+	OptimizeStats stats;
+	const Result result = compareOptimized(build, &stats);
+	EXPECT_EQ(stats.inlined, 1u);
+	EXPECT_EQ(count(result.code, "call "), 0u);
+	EXPECT_EQ(count(result.code, "opr ret"), 0u);
+}
+
+TEST(IRSuite, UnrollingMakesSubscriptsConstant) {
+	// [8]INT a:
+	// INT total:
+	// SEQ
+	//   SEQ i = 0 FOR 8
+	//     a[i] := i + 1
+	//   sum (a, 8, total)
+	//   out ! total
+	auto build = [] {
+		Program program;
+		addProcs(program);
+		program.main = declArray("a", 8, decl("total", seq(
+			seqFor("i", lit(0), lit(8), assignElem("a", var("i"), bin(BinOp::Add, var("i"), lit(1)))),
+			call("sum", var("a"), lit(8), var("total")),
+			output(var("total")))));
+		return program;
+	};
+
+	OptimizeStats stats;
+	Result plain;
+	const Result result = compareOptimized(build, &stats, &plain);
+	EXPECT_EQ(result.out, std::vector<u32>{36});
+	EXPECT_EQ(stats.inlined, 1u);
+	EXPECT_EQ(stats.unrolled, 2u);
+
+	// Every element is now a plain local.
+	EXPECT_GT(count(plain.code, "ldnl "), 0u);
+	EXPECT_EQ(count(result.code, "ldnl "), 0u);
+	EXPECT_EQ(count(result.code, "stnl "), 1u);  // The output.
+	EXPECT_LT(result.ticks, plain.ticks);
+}
+
+TEST(IRSuite, PropagatesConstantsAndAbbreviations) {
+	// [4]INT a:
+	// VAL INT n IS 2:
+	// INT y IS a[n]:
+	// SEQ
+	//   y := 9
+	//   IF
+	//     n = 3
+	//       out ! 0
+	//     n = 2
+	//       out ! a[2] + n
+	auto build = [] {
+		Program program;
+		program.main = declArray("a", 4, valAbbrev("n", lit(2), abbrev("y", elem("a", var("n")), seq(
+			assign("y", lit(9)),
+			ifs(bin(BinOp::Eq, var("n"), lit(3)), output(lit(0)),
+				bin(BinOp::Eq, var("n"), lit(2)),
+				output(bin(BinOp::Add, elem("a", lit(2)), var("n"))))))));
+		return program;
+	};
+
+	OptimizeStats stats;
+	Program optimized = build();
+	Optimizer optimizer(optimized);
+	optimizer.run();
+	EXPECT_GE(optimizer.getStats().propagated, 2u);
+
+	// The IF has folded away, and y has become a[2].
+	const std::string text = toString(*optimized.main);
+	EXPECT_EQ(text.find("IF"), std::string::npos) << text;
+	EXPECT_NE(text.find("a[2] := 9"), std::string::npos) << text;
+
+	const Result result = compareOptimized(build, &stats);
+	EXPECT_EQ(result.out, std::vector<u32>{11});
+	EXPECT_EQ(count(result.code, "cj "), 0u);
+}
+
+TEST(IRSuite, KeepsDeadAssignmentsThatMayFail) {
+	// INT z, x, y:
+	// SEQ
+	//   z := 0
+	//   x := 7 / z
+	//   y := z \ 2
+	//   out ! 5
+	Program program;
+	program.main = decl("z", decl("x", decl("y", seq(
+		assign("z", lit(0)),
+		assign("x", bin(BinOp::Div, lit(7), var("z"))),
+		assign("y", bin(BinOp::Rem, var("z"), lit(2))),
+		output(lit(5))))));
+
+	Optimizer optimizer(program);
+	optimizer.run();
+
+	// Nothing reads x or y, but 7 / 0 is an error and has to stay. z \ 2
+	// cannot fail, so y goes.
+	const std::string text = toString(*program.main);
+	EXPECT_NE(text.find("x := (7 / 0)"), std::string::npos) << text;
+	EXPECT_EQ(text.find("y"), std::string::npos) << text;
+
+	// And it still stops the program.
+	const std::vector<u8> image = assemble(CodeGen(program).generate());
+	Transputer vm;
+	vm.loadProgram(image.data(), image.size());
+	EXPECT_THROW(vm.run(1000), BException);
+}
+
+TEST(IRSuite, UnrollingEvaluatesAVariableBaseOnce) {
+	// INT b, go:
+	// SEQ
+	//   b := 3
+	//   go := 1
+	//   WHILE go = 1
+	//     SEQ
+	//       go := 0
+	//       SEQ i = b FOR 2
+	//         SEQ
+	//           out ! i
+	//           b := b + 10
+	auto build = [] {
+		Program program;
+		program.main = decl("b", decl("go", seq(
+			assign("b", lit(3)),
+			assign("go", lit(1)),
+			whileLoop(bin(BinOp::Eq, var("go"), lit(1)), seq(
+				assign("go", lit(0)),
+				seqFor("i", var("b"), lit(2), seq(
+					output(var("i")),
+					assign("b", bin(BinOp::Add, var("b"), lit(10))))))))));
+		return program;
+	};
+
+	OptimizeStats stats;
+	const Result result = compareOptimized(build, &stats);
+	EXPECT_EQ(result.out, (std::vector<u32>{3, 4}));
+	EXPECT_EQ(stats.unrolled, 1u);
+}
+
+TEST(IRSuite, HoistsInvariantSubscripts) {
+	// [16]INT m:
+	// INT row, total:
+	// SEQ
+	//   row := 2
+	//   total := 0
+	//   SEQ k = 0 FOR 2
+	//     SEQ j = 0 FOR 4
+	//       SEQ
+	//         m[((row + k) * 4) + j] := j
+	//         total := total + m[((row + k) * 4) + j]
+	//   out ! total
+	auto build = [] {
+		auto subscript = [] {
+			return bin(BinOp::Add,
+				bin(BinOp::Mul, bin(BinOp::Add, var("row"), var("k")), lit(4)), var("j"));
+		};
+		Program program;
+		program.main = declArray("m", 16, decl("row", decl("total", seq(
+			assign("row", lit(2)),
+			assign("total", lit(0)),
+			seqFor("k", lit(0), lit(2), seqFor("j", lit(0), lit(4), seq(
+				assignElem("m", subscript(), var("j")),
+				assign("total", bin(BinOp::Add, var("total"), elem("m", subscript())))))),
+			output(var("total"))))));
+		return program;
+	};
+
+	// Unrolling would remove the loops altogether.
+	Program optimized = build();
+	OptimizeOptions options;
+	options.unrolling = false;
+	Optimizer optimizer(optimized, options);
+	optimizer.run();
+	// Both subscripts share one temporary for (row + k) * 4.
+	EXPECT_EQ(optimizer.getStats().hoisted, 1u);
+
+	Program original = build();
+	const Result before = compileAndRun(original);
+	const Result after = compileAndRun(optimized);
+	EXPECT_EQ(before.out, std::vector<u32>{12});
+	EXPECT_EQ(after.out, before.out);
+	EXPECT_LT(after.ticks, before.ticks);
+	EXPECT_LT(count(after.code, "opr mul"), count(before.code, "opr mul"));
+}
+
+TEST(IRSuite, OptimizedFilterMatches) {
+	// A four-tap FIR filter over a ramp:
+	//
+	// PROC fir ([]INT x, []INT h, INT y)
+	//   SEQ
+	//     y := 0
+	//     SEQ t = 0 FOR 4
+	//       y := y + (h[t] * x[t])
+	// [4]INT h, x:
+	// INT y:
+	// SEQ
+	//   h[0] := 1; h[1] := 2; h[2] := 3; h[3] := 4
+	//   SEQ t = 0 FOR 4
+	//     x[t] := 0
+	//   SEQ s = 0 FOR 10
+	//     SEQ
+	//       SEQ t = 0 FOR 3
+	//         x[3 - t] := x[2 - t]
+	//       x[0] := s
+	//       fir (x, h, y)
+	//       out ! y
+	auto build = [] {
+		Program program;
+		program.procs.push_back({"fir",
+			{{"x", Param::Mode::Array}, {"h", Param::Mode::Array}, {"y", Param::Mode::Var}},
+			seq(
+				assign("y", lit(0)),
+				seqFor("t", lit(0), lit(4),
+					assign("y", bin(BinOp::Add, var("y"),
+						bin(BinOp::Mul, elem("h", var("t")), elem("x", var("t")))))))});
+
+		std::vector<ProcPtr> body;
+		for (u32 i = 0; i < 4; ++i) body.push_back(assignElem("h", lit(i), lit(i + 1)));
+		body.push_back(seqFor("t", lit(0), lit(4), assignElem("x", var("t"), lit(0))));
+		body.push_back(seqFor("s", lit(0), lit(10), seq(
+			seqFor("t", lit(0), lit(3),
+				assignElem("x", bin(BinOp::Sub, lit(3), var("t")),
+					elem("x", bin(BinOp::Sub, lit(2), var("t"))))),
+			assignElem("x", lit(0), var("s")),
+			call("fir", var("x"), var("h"), var("y")),
+			output(var("y")))));
+
+		program.main = declArray("h", 4, declArray("x", 4, decl("y", seq(std::move(body)))));
+		return program;
+	};
+
+	OptimizeStats stats;
+	Result plain;
+	const Result result = compareOptimized(build, &stats, &plain);
+	EXPECT_EQ(result.out, (std::vector<u32>{0, 1, 4, 10, 20, 30, 40, 50, 60, 70}));
+	EXPECT_EQ(stats.inlined, 1u);
+	EXPECT_LT(result.ticks, plain.ticks);
+}
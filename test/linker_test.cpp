@@ -0,0 +1,178 @@
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+#include "asm.h"
+#include "Linker.h"
+#include "VMHost.h"
+
+#include "test_util.h"
+
+namespace {
+	// Doubles 5 with an exported PROC from LIBRARY, sends the result on
+	// link 0 and halts.
+	const std::string MAIN =
+		"ajw 8\n"
+		"ldc 5\n"
+		"call P_double:\n"
+		"ldc -2147483648\n"
+		"stnl 0\n"
+		"j __end:\n";
+
+	const std::string LIBRARY =
+		"P_double:\n"
+		"  ldl 1\n"
+		"  ldl 1\n"
+		"  opr add\n"
+		"  opr ret\n"
+		"unused:\n"
+		"  ldc 99\n"
+		"  opr ret\n";
+
+	/// Assembles @source into an object and returns its path.
+	std::string assembleObject(const std::string& name, const std::string& source) {
+		const std::string in = tempPath("link_" + name + ".s");
+		const std::string out = tempPath("link_" + name + ".o");
+		std::ofstream(in, std::ios::trunc) << source;
+		{
+			Assembler assembler(in.c_str(), out.c_str());
+			assembler.runObject();
+		}
+		return out;
+	}
+}
+
+TEST(LinkerSuite, LinksCallAcrossObjects) {
+	Linker linker({assembleObject("main", MAIN), assembleObject("lib", LIBRARY)});
+	Linker::Stats stats;
+	const std::vector<u8> image = linker.link(stats);
+
+	// The library's unlabelled prologue and `unused` are dropped.
+	EXPECT_EQ(stats.sections, 4u);
+	EXPECT_EQ(stats.keptSections, 2u);
+	EXPECT_EQ(stats.imageSize, image.size());
+
+	Channel channel;
+	VMHost host;
+	const VMHandle vm = host.create(1024);
+	host.load(vm, image.data(), image.size());
+	host.setLinkHandlers(vm, handlersFor(channel));
+	EXPECT_TRUE(host.get(vm).isVerified()) << host.get(vm).getVerifyError();
+
+	const RunResult result = host.run(vm, 1000);
+	EXPECT_EQ(result.status, RunStatus::Halted);
+	EXPECT_EQ(result.error, "");
+	EXPECT_EQ(channel.out, std::vector<u32>{10});
+}
+
+TEST(LinkerSuite, MatchesSingleObjectAssembly) {
+	const std::string source =
+		"ldc 2\n"
+		"cj skip:\n"
+		"ldc 7\n"
+		"skip:\n"
+		"j skip:\n";
+
+	Linker linker({assembleObject("whole", source)});
+	Linker::Stats stats;
+	EXPECT_EQ(linker.link(stats), assemble(source));
+}
+
+TEST(LinkerSuite, RejectsUndefinedSymbol) {
+	Linker linker({assembleObject("main", MAIN)});
+	Linker::Stats stats;
+	EXPECT_THROW(linker.link(stats), BException);
+}
+
+TEST(LinkerSuite, KeepsLabelsLocalToTheirObject) {
+	// Both objects use `loop:`; each jump must stay within its own object.
+	const std::string main =
+		"ajw 8\n"
+		"ldc 2\n"
+		"stl 1\n"
+		"loop:\n"
+		"ldl 1\n"
+		"cj done:\n"
+		"ldl 1\n"
+		"adc -1\n"
+		"stl 1\n"
+		"j loop:\n"
+		"done:\n"
+		"call P_three:\n"
+		"ldc -2147483648\n"
+		"stnl 0\n"
+		"j __end:\n";
+
+	const std::string library =
+		"P_three:\n"
+		"  j loop:\n"
+		"loop:\n"
+		"  ldc 3\n"
+		"  opr ret\n";
+
+	Linker linker({assembleObject("local_main", main),
+	               assembleObject("local_lib", library)});
+	Linker::Stats stats;
+	const std::vector<u8> image = linker.link(stats);
+
+	Channel channel;
+	VMHost host;
+	const VMHandle vm = host.create(1024);
+	host.load(vm, image.data(), image.size());
+	host.setLinkHandlers(vm, handlersFor(channel));
+
+	const RunResult result = host.run(vm, 1000);
+	EXPECT_EQ(result.status, RunStatus::Halted);
+	EXPECT_EQ(result.error, "");
+	EXPECT_EQ(channel.out, std::vector<u32>{3});
+}
+
+TEST(LinkerSuite, RejectsDuplicateSymbol) {
+	Linker linker({assembleObject("main", MAIN), assembleObject("lib", LIBRARY),
+	               assembleObject("lib2", LIBRARY)});
+	Linker::Stats stats;
+	EXPECT_THROW(linker.link(stats), BException);
+}
+
+TEST(LinkerSuite, RejectsFallThroughIntoAnotherObject) {
+	// Unlike MAIN, this runs off the end of its object. That halts when
+	// nothing follows, but would otherwise run on into the library.
+	const std::string open = "ajw 8\nldc 5\ncall P_double:\n";
+	Linker::Stats stats;
+
+	Linker alone({assembleObject("open_alone", "ldc 5\n")});
+	EXPECT_NO_THROW(alone.link(stats));
+
+	Linker linker({assembleObject("open", open), assembleObject("lib", LIBRARY)});
+	EXPECT_THROW(linker.link(stats), BException);
+}
+
+TEST(LinkerSuite, RejectsRelocationPastSectionEnd) {
+	// One 8-byte section whose relocation offset would wrap past the end.
+	std::vector<u8> object;
+	auto putU32 = [&](const u32 value) {
+		for (int shift = 0; shift < 32; shift += 8) object.push_back(value >> shift);
+	};
+
+	putU32(ObjectFormat::OBJECT_MAGIC);
+	putU32(ObjectFormat::VERSION);
+	putU32(1);
+	putU32(0);                        // Empty label.
+	object.insert(object.end(), sizeof(u64), 0);
+	object.push_back(0);              // Does not fall through.
+	putU32(Assembler::JUMP_SIZE);
+	object.insert(object.end(), Assembler::JUMP_SIZE, 0);
+	putU32(1);
+	putU32(0xFFFFFFFC);               // offset + JUMP_SIZE wraps to 4.
+	object.push_back(0);
+	putU32(Linker::END_SYMBOL.size());
+	object.insert(object.end(), Linker::END_SYMBOL.begin(), Linker::END_SYMBOL.end());
+
+	const std::string path = tempPath("link_wrap.o");
+	std::ofstream(path, std::ios::binary | std::ios::trunc)
+		.write(reinterpret_cast<const char*>(object.data()), object.size());
+
+	Linker linker({path});
+	Linker::Stats stats;
+	EXPECT_THROW(linker.link(stats), BException);
+}
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+
+#include "Memory.h"
+
+TEST(MemorySuite, WordRoundTrip) {
+	WriteableMemory mem(64);
+
+	const u32 words[] = {0x0, 0x1, 0xDEADBEEF, 0x80000000, 0xFFFFFFFF, 0x01020304};
+	for (const u32 word: words) {
+		for (u32 addr = 0; addr < 64; addr += 4) {
+			mem.writeWord(addr, word);
+			EXPECT_EQ(mem.readWord(addr), word);
+		}
+	}
+}
+
+TEST(MemorySuite, WordsAreLittleEndian) {
+	WriteableMemory mem(16);
+
+	mem.writeWord(4, 0x11223344);
+	EXPECT_EQ(mem.readByte(4), 0x44);
+	EXPECT_EQ(mem.readByte(5), 0x33);
+	EXPECT_EQ(mem.readByte(6), 0x22);
+	EXPECT_EQ(mem.readByte(7), 0x11);
+
+	mem.writeByte(8, 0xEF);
+	mem.writeByte(9, 0xBE);
+	mem.writeByte(10, 0xAD);
+	mem.writeByte(11, 0xDE);
+	EXPECT_EQ(mem.readWord(8), 0xDEADBEEF);
+}
+
+TEST(MemorySuite, WordWriteLeavesNeighboursIntact) {
+	WriteableMemory mem(12);
+
+	mem.writeWord(0, 0xAAAAAAAA);
+	mem.writeWord(8, 0xBBBBBBBB);
+	mem.writeWord(4, 0x12345678);
+	EXPECT_EQ(mem.readWord(0), 0xAAAAAAAA);
+	EXPECT_EQ(mem.readWord(4), 0x12345678);
+	EXPECT_EQ(mem.readWord(8), 0xBBBBBBBB);
+}
+
+TEST(MemorySuite, WordAccessChecks) {
+	WriteableMemory mem(16);
+
+	EXPECT_THROW(mem.readWord(2), BException);
+	EXPECT_THROW(mem.writeWord(6, 0), BException);
+	EXPECT_THROW(mem.readWord(16), BException);
+	EXPECT_THROW(mem.writeWord(0xFFFFFFFC, 0), BException);
+	EXPECT_NO_THROW(mem.readWord(12));
+
+	WriteableMemory tiny(2);
+	EXPECT_THROW(tiny.readWord(0), BException);
+}
+
+TEST(MemorySuite, BlockOperations) {
+	WriteableMemory mem(32);
+
+	for (u32 i = 0; i < 16; ++i) mem.writeByte(i, i + 1);
+
+	// Overlapping move behaves like memmove.
+	mem.moveBlock(4, 0, 16);
+	for (u32 i = 0; i < 16; ++i) EXPECT_EQ(mem.readByte(4 + i), i + 1);
+
+	mem.clearBlock(8, 8);
+	for (u32 i = 8; i < 16; ++i) EXPECT_EQ(mem.readByte(i), 0);
+	EXPECT_EQ(mem.readByte(16), 13);
+
+	EXPECT_THROW(mem.moveBlock(20, 0, 16), BException);
+	EXPECT_THROW(mem.clearBlock(0xFFFFFFF0, 32), BException);
+	EXPECT_NO_THROW(mem.clearBlock(100, 0));
+}
+
+TEST(MemorySuite, ResetDirtyClearsOnlyWrittenPages) {
+	const u32 page = WriteableMemory::PAGE_SIZE;
+	WriteableMemory mem(4 * page + 100);
+
+	mem.writeWord(page + 8, 0xCAFEBABE);
+	mem.writeByte(4 * page + 99, 0x7F);
+	mem.moveBlock(2 * page - 2, page + 8, 4);
+
+	EXPECT_FALSE(mem.isDirty(0));
+	EXPECT_TRUE(mem.isDirty(page));
+	EXPECT_TRUE(mem.isDirty(2 * page));
+	EXPECT_FALSE(mem.isDirty(3 * page));
+	EXPECT_TRUE(mem.isDirty(4 * page));
+
+	mem.resetDirty();
+	for (u32 i = 0; i < mem.getSize(); ++i) ASSERT_EQ(mem.readByte(i), 0);
+	EXPECT_FALSE(mem.isDirty(page));
+	EXPECT_FALSE(mem.isDirty(4 * page));
+}
+
+TEST(MemorySuite, ReportsStoresToCodePages) {
+	const u32 page = WriteableMemory::PAGE_SIZE;
+	WriteableMemory mem(4 * page);
+
+	mem.markCode(page + 100, 8);
+	mem.writeWord(0, 1);
+	mem.writeWord(2 * page, 1);
+	EXPECT_FALSE(mem.codeWritten());
+
+	mem.writeByte(page + 4000, 1);
+	mem.writeWord(page + 8, 1);
+	ASSERT_TRUE(mem.codeWritten());
+	EXPECT_EQ(mem.takeWrittenCode(), std::vector<u32>{1});
+	EXPECT_FALSE(mem.codeWritten());
+
+	// Block moves and clears report code pages too.
+	mem.markCode(3 * page, 4);
+	mem.clearBlock(3 * page - 4, 8);
+	EXPECT_EQ(mem.takeWrittenCode(), std::vector<u32>{3});
+
+	mem.markCode(2 * page, 4);
+	mem.moveBlock(2 * page - 2, 0, 4);
+	EXPECT_EQ(mem.takeWrittenCode(), std::vector<u32>{2});
+}
@@ -0,0 +1,95 @@
+#include <cstdlib>
+
+#include "gtest/gtest.h"
+
+#include "placement.h"
+
+namespace {
+	/// `PAR i = 0 FOR n` where process i talks to i + 1.
+	ProcessGraph pipeline(const u32 n) {
+		ProcessGraph graph;
+		for (u32 i = 0; i < n; ++i) graph.addProcess(100);
+		for (u32 i = 0; i + 1 < n; ++i) graph.addChannel(i, i + 1, 10);
+		return graph;
+	}
+
+	/// A @side by @side stencil: every process talks to its four neighbours.
+	ProcessGraph stencil(const u32 side) {
+		ProcessGraph graph;
+		for (u32 i = 0; i < side * side; ++i) graph.addProcess(100);
+		for (u32 y = 0; y < side; ++y) {
+			for (u32 x = 0; x < side; ++x) {
+				const u32 p = y * side + x;
+				if (x + 1 < side) graph.addChannel(p, p + 1, 10);
+				if (y + 1 < side) graph.addChannel(p, p + side, 10);
+			}
+		}
+		return graph;
+	}
+
+	/// Cost of dealing processes out to nodes in turn.
+	u64 roundRobinCost(const ProcessGraph& graph, const Topology& topology) {
+		u64 cost = 0;
+		for (const ProcessGraph::Channel& channel: graph.channels) {
+			const u32 from = channel.from % topology.size();
+			const u32 to = channel.to % topology.size();
+			cost += channel.traffic * (from == to ? 0 :
+				std::abs((int)(from % 2) - (int)(to % 2)) +
+				std::abs((int)(from / 2) - (int)(to / 2)));
+		}
+		return cost;
+	}
+}
+
+TEST(PlacementSuite, KeepsPipelineStagesTogether) {
+	const ProcessGraph graph = pipeline(8);
+	const Topology topology = Topology::mesh(2, 2);
+	const Placement placement = Placer(graph, topology, 0).place();
+
+	// Four nodes of two consecutive stages: only three channels cross a
+	// link, each over a single hop.
+	EXPECT_EQ(placement.cost, 30u);
+	for (const u64 load: placement.nodeLoad) EXPECT_EQ(load, 200u);
+}
+
+TEST(PlacementSuite, BeatsRoundRobinOnStencil) {
+	const ProcessGraph graph = stencil(4);
+	const Topology topology = Topology::mesh(2, 2);
+	const Placement placement = Placer(graph, topology).place();
+
+	EXPECT_LT(placement.cost, roundRobinCost(graph, topology));
+	for (const u64 load: placement.nodeLoad) EXPECT_LE(load, 440u);
+}
+
+TEST(PlacementSuite, RoutesFollowTheWiring) {
+	ProcessGraph graph;
+	const u32 a = graph.addProcess(100), b = graph.addProcess(100);
+	const u32 c = graph.addProcess(100);
+	graph.addChannel(a, b, 1);
+	graph.addChannel(a, c, 1);
+
+	const Topology topology = Topology::mesh(3, 1);
+	const Placement placement = Placer(graph, topology, 0).place();
+
+	for (u32 ch = 0; ch < graph.channels.size(); ++ch) {
+		u32 node = placement.nodeOf[graph.channels[ch].from];
+		for (const Placement::Hop& hop: placement.routes[ch]) {
+			ASSERT_EQ(hop.node, node);
+			node = topology.wiring[hop.node][hop.link].node;
+		}
+		EXPECT_EQ(node, placement.nodeOf[graph.channels[ch].to]);
+	}
+}
+
+TEST(PlacementSuite, RejectsBadInput) {
+	ProcessGraph graph = pipeline(2);
+	graph.addChannel(0, 5, 1);
+	EXPECT_THROW(Placer(graph, Topology::mesh(2, 2)), BException);
+
+	// Two nodes with no link between them.
+	EXPECT_THROW(Placer(pipeline(2), Topology(2)), BException);
+
+	Topology topology(2);
+	topology.connect(0, 0, 1, 0);
+	EXPECT_THROW(topology.connect(0, 0, 1, 1), BException);
+}
@@ -0,0 +1,127 @@
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+#include "Profile.h"
+#include "Transputer.h"
+
+#include "test_util.h"
+
+namespace {
+	// Counts down from 3.
+	const std::string COUNTDOWN =
+		"ldc 3\n"
+		"stl 0\n"
+		"loop:\n"
+		"  ldl 0\n"
+		"  adc -1\n"
+		"  stl 0\n"
+		"  ldl 0\n"
+		"  cj end:\n"
+		"  j loop:\n"
+		"end:\n";
+}
+
+TEST(ProfileSuite, AttributesEveryInstruction) {
+	const std::vector<u8> image = assemble(COUNTDOWN);
+
+	Transputer plain;
+	plain.loadProgram(image.data(), image.size());
+	ASSERT_EQ(plain.run(~0ull), RunStatus::Halted);
+
+	Profile profile(Profile::Granularity::Instruction);
+	Transputer vm;
+	vm.loadProgram(image.data(), image.size());
+	vm.setProfile(&profile);
+	ASSERT_EQ(vm.run(~0ull), RunStatus::Halted);
+
+	// Profiling does not change what runs.
+	EXPECT_EQ(vm.getTickCount(), plain.getTickCount());
+	EXPECT_EQ(profile.getTotal().ticks, vm.getTickCount());
+
+	EXPECT_EQ(profile.getClass(OpClass::Constant).execs, 4u);
+	EXPECT_EQ(profile.getClass(OpClass::Local).execs, 10u);
+	EXPECT_EQ(profile.getClass(OpClass::Jump).execs, 5u);
+	EXPECT_EQ(profile.getClass(OpClass::Arithmetic).execs, 0u);
+
+	u64 classTicks = 0, blockTicks = 0, classNanos = 0;
+	for (u32 i = 0; i < OP_CLASS_COUNT; ++i) {
+		classTicks += profile.getClass(static_cast<OpClass>(i)).ticks;
+		classNanos += profile.getClass(static_cast<OpClass>(i)).cost.nanos;
+	}
+	for (const auto& [addr, entry]: profile.getBlocks()) blockTicks += entry.ticks;
+	EXPECT_EQ(classTicks, profile.getTotal().ticks);
+	EXPECT_EQ(blockTicks, profile.getTotal().ticks);
+	EXPECT_EQ(classNanos, profile.getTotal().cost.nanos);
+
+	// The first iteration falls through from the entry block, the others
+	// jump back to the loop head.
+	const u32 loopHead = vm.getCodeBase() + 2;
+	ASSERT_EQ(profile.getBlocks().count(loopHead), 1u);
+	EXPECT_EQ(profile.getBlocks().at(loopHead).execs, 2u);
+}
+
+TEST(ProfileSuite, BlockGranularityOnlyCountsClasses) {
+	const std::vector<u8> image = assemble(COUNTDOWN);
+
+	Profile profile(Profile::Granularity::Block);
+	Transputer vm;
+	vm.loadProgram(image.data(), image.size());
+	vm.setProfile(&profile);
+	ASSERT_EQ(vm.run(~0ull), RunStatus::Halted);
+
+	EXPECT_EQ(profile.getTotal().ticks, vm.getTickCount());
+	EXPECT_EQ(profile.getClass(OpClass::Jump).execs, 5u);
+	EXPECT_EQ(profile.getClass(OpClass::Jump).cost.nanos, 0u);
+
+	u64 blockNanos = 0;
+	for (const auto& [addr, entry]: profile.getBlocks()) blockNanos += entry.cost.nanos;
+	EXPECT_EQ(blockNanos, profile.getTotal().cost.nanos);
+
+	std::ostringstream report;
+	profile.print(report);
+	EXPECT_NE(report.str().find("jump"), std::string::npos);
+	EXPECT_NE(report.str().find("-- by block"), std::string::npos);
+}
+
+TEST(ProfileSuite, SurvivesLinkStalls) {
+	// Reads a word from link 0, then sends it back.
+	const std::vector<u8> image = assemble(
+		"ldc -2147483632\nldnl 0\nldc -2147483648\nstnl 0\n");
+
+	Profile profile(Profile::Granularity::Instruction);
+	Transputer vm;
+	vm.loadProgram(image.data(), image.size());
+	vm.setProfile(&profile);
+	ASSERT_EQ(vm.run(~0ull), RunStatus::Blocked);
+
+	LinkHandlers handlers;
+	handlers.in = [](void *, u32, u32& word) { word = 7; return true; };
+	handlers.out = [](void *, u32, u32) { return true; };
+	vm.setLinkHandlers(handlers);
+	ASSERT_EQ(vm.run(~0ull), RunStatus::Halted);
+
+	// The stalled load is counted once, when it completes.
+	EXPECT_EQ(profile.getClass(OpClass::NonLocal).execs, 2u);
+	EXPECT_EQ(profile.getTotal().ticks, vm.getTickCount());
+}
+
+TEST(ProfileSuite, CountersFallBackToTheClock) {
+	PerfCounters counters;
+
+	bool any = false;
+	for (u32 i = 0; i < PERF_EVENT_COUNT; ++i) any |= counters.has(static_cast<PerfEvent>(i));
+	EXPECT_EQ(any, counters.hasHardware());
+
+	PerfSample before, after;
+	counters.read(before);
+	counters.read(after);
+	EXPECT_GT(before.nanos, 0u);
+	EXPECT_GE(after.nanos, before.nanos);
+
+	for (u32 i = 0; i < PERF_EVENT_COUNT; ++i) {
+		if (!counters.has(static_cast<PerfEvent>(i))) {
+			EXPECT_EQ(after.events[i], 0u);
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "asm.h"
+#include "Transputer.h"
+
+// Helpers shared by the test suites.
+
+// ldc 0x80000000 - the address of link 0 output.
+inline const std::vector<u8> LDC_LINK0_OUT = {
+	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60};
+// ldc 0x80000010 - the address of link 0 input.
+inline const std::vector<u8> LDC_LINK0_IN = {
+	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x60};
+
+/// A scratch file path for @name, in gtest's temporary directory.
+inline std::string tempPath(const std::string& name) {
+	return ::testing::TempDir() + "occam_" + name;
+}
+
+/// Assembles @source into an image file named after @name, and returns its
+/// path.
+inline std::string assembleFile(const std::string& name, const std::string& source) {
+	const std::string in = tempPath(name + ".s"), out = tempPath(name + ".bin");
+	std::ofstream(in, std::ios::trunc) << source;
+	{
+		Assembler assembler(in.c_str(), out.c_str());
+		assembler.run();
+	}
+	return out;
+}
+
+/// The running test as Suite.Name, or "prog" outside of a test. Naming
+/// scratch files after it keeps tests run in parallel from sharing them.
+inline std::string testName() {
+	const ::testing::TestInfo *test =
+		::testing::UnitTest::GetInstance()->current_test_info();
+	return test
+		? std::string(test->test_suite_name()) + "." + test->name()
+		: "prog";
+}
+
+/// Assembles @source and returns the image, using scratch files named
+/// after the running test.
+inline std::vector<u8> assemble(const std::string& source) {
+	std::ifstream bin(assembleFile(testName(), source), std::ios::binary);
+	return std::vector<u8>(std::istreambuf_iterator<char>(bin), {});
+}
+
+/// Words queued for link 0 input, and words the program sent on link 0.
+struct Channel {
+	std::deque<u32> in;
+	std::vector<u32> out;
+};
+
+/// Link handlers that connect link 0 to @channel. Other links never
+/// complete.
+inline LinkHandlers handlersFor(Channel& channel) {
+	LinkHandlers handlers;
+	handlers.ctx = &channel;
+	handlers.in = [](void *ctx, u32 link, u32& word) {
+		auto& ch = *static_cast<Channel*>(ctx);
+		if (link != 0 || ch.in.empty()) return false;
+		word = ch.in.front();
+		ch.in.pop_front();
+		return true;
+	};
+	handlers.out = [](void *ctx, u32 link, u32 word) {
+		if (link != 0) return false;
+		static_cast<Channel*>(ctx)->out.push_back(word);
+		return true;
+	};
+	return handlers;
+}
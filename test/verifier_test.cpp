@@ -0,0 +1,136 @@
+#include "gtest/gtest.h"
+
+#include "Verifier.h"
+#include "VMHost.h"
+
+#include "test_util.h"
+
+namespace {
+	// ajw 4; call f; ldc 42; ldc link0.out; stnl 0; j end; f: <callee>
+	std::vector<u8> callProgram(const std::vector<u8>& callee) {
+		std::vector<u8> image = {0xF4, 0xEC, 0x02, 0x6A};
+		image.insert(image.end(), LDC_LINK0_OUT.begin(), LDC_LINK0_OUT.end());
+		image.push_back(0xC0);
+		image.push_back(0x90 | static_cast<u8>(callee.size()));
+		image.insert(image.end(), callee.begin(), callee.end());
+		return image;
+	}
+
+	VerifyResult verify(const std::vector<u8>& image) {
+		return Verifier::verify(image, 1024);
+	}
+}
+
+TEST(VerifierSuite, AcceptsCallAndRet) {
+	// ret
+	const std::vector<u8> image = callProgram({0x02, 0x20});
+	const VerifyResult result = verify(image);
+	EXPECT_TRUE(result.ok) << result.error;
+	// The ret there has to restore the caller's four-word workspace.
+	EXPECT_EQ(result.retTargets[2], 16u);
+
+	Channel channel;
+	Transputer vm(1024);
+	vm.loadProgram(image.data(), image.size());
+	vm.setLinkHandlers(handlersFor(channel));
+	EXPECT_TRUE(vm.isVerified());
+	EXPECT_EQ(vm.run(100), RunStatus::Halted);
+	EXPECT_EQ(channel.out, std::vector<u32>{42});
+}
+
+TEST(VerifierSuite, AcceptsNestedCalls) {
+	// f: ajw -2; call g; ajw 2; ret
+	// g: ret
+	std::vector<u8> image = callProgram({0x10, 0xFE, 0xE3, 0xF2, 0x02, 0x20,
+	                                     0x02, 0x20});
+	image[0] = 0xFC; // ajw 12 - room for both frames.
+	const VerifyResult result = verify(image);
+	EXPECT_TRUE(result.ok) << result.error;
+
+	Channel channel;
+	Transputer vm(1024);
+	vm.loadProgram(image.data(), image.size());
+	vm.setLinkHandlers(handlersFor(channel));
+	EXPECT_TRUE(vm.isVerified());
+	EXPECT_EQ(vm.run(100), RunStatus::Halted);
+	EXPECT_EQ(channel.out, std::vector<u32>{42});
+}
+
+TEST(VerifierSuite, RejectsUnbalancedNestedRet) {
+	// f: ajw -2; call g; ajw 2; ret
+	// g: ajw 1; ret - one word above the workspace g was entered at.
+	std::vector<u8> image = callProgram({0x10, 0xFE, 0xE3, 0xF2, 0x02, 0x20,
+	                                     0xF1, 0x02, 0x20});
+	image[0] = 0xFC;
+	EXPECT_FALSE(verify(image).ok);
+}
+
+TEST(VerifierSuite, ChecksReturnToAnOuterCall) {
+	// f: ajw -2; call g; ajw 2; ret
+	// g: ldl 6; stl 0; ret - takes f's return address, which follows a
+	// call, but one made from another workspace.
+	std::vector<u8> image = callProgram({0x10, 0xFE, 0xE3, 0xF2, 0x02, 0x20,
+	                                     0x36, 0x40, 0x02, 0x20});
+	image[0] = 0xFC;
+
+	Transputer vm;
+	vm.loadProgram(image.data(), image.size());
+	EXPECT_TRUE(vm.isVerified()) << vm.getVerifyError();
+	EXPECT_THROW(vm.run(100), BException);
+}
+
+TEST(VerifierSuite, ChecksOverwrittenReturnAddress) {
+	// ldc 0; stl 0; ret - returns to the start of the program.
+	const std::vector<u8> image = callProgram({0x60, 0x40, 0x02, 0x20});
+
+	// The workspace has to be on another page than the code, or the store
+	// would count as one into the code, and drop to the checked interpreter.
+	Transputer vm;
+	vm.loadProgram(image.data(), image.size());
+	EXPECT_TRUE(vm.isVerified());
+	EXPECT_THROW(vm.run(100), BException);
+}
+
+TEST(VerifierSuite, RejectsJumpIntoPrefixChain) {
+	// j 1; pfix 2; ldc 0xA
+	EXPECT_FALSE(verify({0x91, 0x02, 0x6A}).ok);
+	// j 0; pfix 2; ldc 0xA
+	EXPECT_TRUE(verify({0x90, 0x02, 0x6A}).ok);
+	// j 2 - to the end of the image, which halts.
+	EXPECT_TRUE(verify({0x92, 0x02, 0x6A}).ok);
+	// j 3 - past the end.
+	EXPECT_FALSE(verify({0x93, 0x02, 0x6A}).ok);
+}
+
+TEST(VerifierSuite, RejectsInconsistentWorkspace) {
+	// cj 1; ajw 1; ldc 0
+	EXPECT_FALSE(verify({0xA1, 0xF1, 0x60}).ok);
+	// cj 1; ldc 1; ldc 0
+	EXPECT_TRUE(verify({0xA1, 0x61, 0x60}).ok);
+}
+
+TEST(VerifierSuite, RejectsWorkspaceOutOfBounds) {
+	// ldl 0xFFF
+	const std::vector<u8> image = {0x0F, 0x0F, 0x3F};
+	EXPECT_FALSE(verify(image).ok);
+	// ajw 254; ldl 1 - the last word of a 1024 byte workspace.
+	EXPECT_TRUE(verify({0x0F, 0xFE, 0x31}).ok);
+	// ajw 255; ldl 1 - one past it.
+	EXPECT_FALSE(verify({0x0F, 0xFF, 0x31}).ok);
+	// ajw -1; ldl 0
+	EXPECT_FALSE(verify({0x10, 0xFF, 0x30}).ok);
+
+	// Unverified images still run, on the checked interpreter.
+	VMHost host;
+	const VMHandle vm = host.create(1024);
+	host.load(vm, image.data(), image.size());
+	EXPECT_FALSE(host.get(vm).isVerified());
+	EXPECT_FALSE(host.run(vm, 10).error.empty());
+}
+
+TEST(VerifierSuite, RejectsUnknownOpsAndTruncatedPrefixes) {
+	// opr 0xD
+	EXPECT_FALSE(verify({0x2D}).ok);
+	// ldc 1; pfix 1
+	EXPECT_FALSE(verify({0x61, 0x01}).ok);
+}
@@ -0,0 +1,236 @@
+#include "gtest/gtest.h"
+
+#include "asm.h"
+#include "TransputerPool.h"
+#include "VMHost.h"
+
+#include "test_util.h"
+
+TEST(VMHostSuite, RunsProgramAndWritesLink) {
+	// ldc 5; ldc link0.out; stnl 0
+	std::vector<u8> image = {0x65};
+	image.insert(image.end(), LDC_LINK0_OUT.begin(), LDC_LINK0_OUT.end());
+	image.push_back(0xC0);
+
+	VMHost host;
+	Channel channel;
+	const VMHandle vm = host.create(1024);
+	host.load(vm, image.data(), image.size());
+	host.setLinkHandlers(vm, handlersFor(channel));
+
+	const RunResult result = host.run(vm, 100);
+	EXPECT_EQ(result.status, RunStatus::Halted);
+	EXPECT_EQ(result.ticks, image.size());
+	ASSERT_EQ(channel.out.size(), 1u);
+	EXPECT_EQ(channel.out[0], 5u);
+}
+
+TEST(VMHostSuite, BlocksOnEmptyInputAndResumes) {
+	// ldc link0.in; ldnl 0; adc 1; ldc link0.out; stnl 0
+	std::vector<u8> image(LDC_LINK0_IN);
+	image.insert(image.end(), {0xB0, 0x71});
+	image.insert(image.end(), LDC_LINK0_OUT.begin(), LDC_LINK0_OUT.end());
+	image.push_back(0xC0);
+
+	VMHost host;
+	Channel channel;
+	const VMHandle vm = host.create(1024);
+	host.load(vm, image.data(), image.size());
+	host.setLinkHandlers(vm, handlersFor(channel));
+
+	EXPECT_EQ(host.run(vm, 100).status, RunStatus::Blocked);
+	EXPECT_EQ(host.run(vm, 100).status, RunStatus::Blocked);
+
+	channel.in.push_back(41);
+	EXPECT_EQ(host.run(vm, 3).status, RunStatus::BudgetExhausted);
+	EXPECT_EQ(host.run(vm, 100).status, RunStatus::Halted);
+	ASSERT_EQ(channel.out.size(), 1u);
+	EXPECT_EQ(channel.out[0], 42u);
+}
+
+TEST(VMHostSuite, ReusesSlotsAndRejectsStaleHandles) {
+	VMHost host;
+
+	std::vector<VMHandle> handles;
+	for (int i = 0; i < 3000; ++i) handles.push_back(host.create());
+	EXPECT_EQ(host.size(), 3000u);
+
+	const VMHandle stale = handles[17];
+	host.destroy(stale);
+	EXPECT_THROW(host.get(stale), BException);
+
+	const VMHandle fresh = host.create();
+	EXPECT_NE(fresh, stale);
+	EXPECT_EQ(static_cast<u32>(fresh), static_cast<u32>(stale));
+	EXPECT_NO_THROW(host.get(fresh));
+	EXPECT_EQ(host.size(), 3000u);
+}
+
+TEST(VMHostSuite, ReportsFaults) {
+	// ldc 0x7FFFFFF0; ldnl 0 - reads far outside a 16 byte memory.
+	const std::vector<u8> image = {
+		0x07, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x60, 0xB0};
+
+	VMHost host;
+	const VMHandle vm = host.create(16);
+	host.load(vm, image.data(), image.size());
+
+	const RunResult result = host.run(vm, 100);
+	EXPECT_EQ(result.status, RunStatus::Faulted);
+	EXPECT_FALSE(result.error.empty());
+}
+
+TEST(TransputerPoolSuite, RecyclesInstancesWithCleanState) {
+	// ldc 5; stl 3; ldc 7
+	const std::vector<u8> image = {0x65, 0x43, 0x67};
+
+	TransputerPool pool(2, 1024);
+	EXPECT_EQ(pool.available(), 2u);
+
+	Profile profile;
+	Transputer *vm = pool.acquire();
+	vm->loadProgram(image.data(), image.size());
+	vm->setProfile(&profile);
+	EXPECT_EQ(vm->run(100), RunStatus::Halted);
+	pool.release(vm);
+	EXPECT_EQ(profile.getTotal().ticks, image.size());
+
+	// Pool is LIFO, so the same instance comes back - reset and zeroed,
+	// and no longer reporting to the previous owner's profile.
+	Transputer *again = pool.acquire();
+	EXPECT_EQ(again, vm);
+	EXPECT_EQ(again->getTickCount(), 0u);
+
+	// ldl 3; ldc link0.out; stnl 0 - must observe a zeroed workspace.
+	std::vector<u8> probe = {0x33};
+	probe.insert(probe.end(), LDC_LINK0_OUT.begin(), LDC_LINK0_OUT.end());
+	probe.push_back(0xC0);
+
+	Channel channel;
+	again->loadProgram(probe.data(), probe.size());
+	again->setLinkHandlers(handlersFor(channel));
+	EXPECT_EQ(again->run(100), RunStatus::Halted);
+	ASSERT_EQ(channel.out.size(), 1u);
+	EXPECT_EQ(channel.out[0], 0u);
+	EXPECT_EQ(profile.getTotal().ticks, image.size());
+
+	// Draining the pool grows it rather than failing.
+	Transputer *a = pool.acquire();
+	Transputer *b = pool.acquire();
+	EXPECT_NE(a, b);
+	pool.release(a);
+	pool.release(b);
+	pool.release(again);
+	EXPECT_EQ(pool.available(), 3u);
+}
+
+TEST(TransputerSuite, StoresIntoCodeInvalidateDecodedBlocks) {
+	// The program patches four of its own bytes ahead of the store, inside
+	// the block that is being executed:
+	//   ldc 0x67000000; ldc <patch>; stnl 0
+	//   patch: ldc 1; ldc 1; ldc 1; ldc 1 -> pfix 0; pfix 0; pfix 0; ldc 7
+	//   ajw 0; ajw 0; ajw 0; ldc link0.out; stnl 0
+	// The image ends at the top of memory, 16 bytes after the patch.
+	const u32 memSize = 1024;
+	const u32 patchAddr = memSize - 16;
+
+	std::vector<u8> image;
+	Assembler::genPrefixSeq(0x6, 0x67000000, image);
+	Assembler::genPrefixSeq(0x6, patchAddr, image);
+	image.push_back(0xC0);
+	image.insert(image.end(), {0x61, 0x61, 0x61, 0x61, 0xF0, 0xF0, 0xF0});
+	image.insert(image.end(), LDC_LINK0_OUT.begin(), LDC_LINK0_OUT.end());
+	image.push_back(0xC0);
+
+	Channel channel;
+	Transputer vm(memSize);
+	vm.loadProgram(image.data(), image.size());
+	vm.setLinkHandlers(handlersFor(channel));
+	ASSERT_EQ(vm.getCodeBase() + image.size() - 16, patchAddr);
+	EXPECT_TRUE(vm.isVerified());
+
+	EXPECT_EQ(vm.run(1000), RunStatus::Halted);
+	ASSERT_EQ(channel.out.size(), 1u);
+	EXPECT_EQ(channel.out[0], 7u);
+	EXPECT_FALSE(vm.isVerified());
+
+	// Resetting restores the original image, and its proof.
+	vm.reset();
+	EXPECT_TRUE(vm.isVerified());
+	EXPECT_EQ(vm.run(1000), RunStatus::Halted);
+	EXPECT_EQ(channel.out.back(), 7u);
+}
+
+TEST(TransputerSuite, RewrittenCodeRunsChecked) {
+	// As above, but the patch turns into stl 0xFFFF - far outside memory.
+	// The image was verified; what replaces it was not, so the store has
+	// to be caught.
+	//   patch: ldc 1; ldc 1; ldc 1; ldc 1 -> pfix F; pfix F; pfix F; stl F
+	const u32 memSize = 1024;
+	const u32 patchAddr = memSize - 8;
+
+	std::vector<u8> image;
+	Assembler::genPrefixSeq(0x6, 0x4F0F0F0F, image);
+	Assembler::genPrefixSeq(0x6, patchAddr, image);
+	image.push_back(0xC0);
+	image.insert(image.end(), {0x61, 0x61, 0x61, 0x61, 0xF0, 0xF0, 0xF0, 0xF0});
+
+	for (const bool profiled: {false, true}) {
+		Profile profile(Profile::Granularity::Block);
+		Transputer vm(memSize);
+		vm.loadProgram(image.data(), image.size());
+		if (profiled) vm.setProfile(&profile);
+		ASSERT_EQ(vm.getCodeBase() + image.size() - 8, patchAddr);
+		EXPECT_TRUE(vm.isVerified());
+
+		EXPECT_THROW(vm.run(1000), BException);
+		EXPECT_FALSE(vm.isVerified());
+	}
+}
+
+TEST(TransputerSuite, RewrittenLaterPageRunsChecked) {
+	// As above, but the patch lies two pages past the store, on a page that
+	// has not been decoded yet when it is written. A run of ajw 0 leads up
+	// to it.
+	const u32 memSize = 16 * 1024;
+	const u32 patchAddr = memSize - 8;
+	const u32 imageSize = 3 * WriteableMemory::PAGE_SIZE;
+
+	std::vector<u8> image;
+	Assembler::genPrefixSeq(0x6, 0x4F0F0F0F, image);
+	Assembler::genPrefixSeq(0x6, patchAddr, image);
+	image.push_back(0xC0);
+	image.resize(imageSize - 8, 0xF0);
+	image.insert(image.end(), {0x61, 0x61, 0x61, 0x61, 0xF0, 0xF0, 0xF0, 0xF0});
+
+	for (const bool profiled: {false, true}) {
+		Profile profile(Profile::Granularity::Block);
+		Transputer vm(memSize);
+		vm.loadProgram(image.data(), image.size());
+		if (profiled) vm.setProfile(&profile);
+		ASSERT_EQ(vm.getCodeBase() + image.size() - 8, patchAddr);
+		EXPECT_TRUE(vm.isVerified());
+
+		EXPECT_THROW(vm.run(100000), BException);
+		EXPECT_FALSE(vm.isVerified());
+	}
+}
+
+TEST(TransputerSuite, SingleStepsThroughPrefixes) {
+	// pfix 2; ldc 0xA; ldc link0.out; stnl 0
+	std::vector<u8> image = {0x02, 0x6A};
+	image.insert(image.end(), LDC_LINK0_OUT.begin(), LDC_LINK0_OUT.end());
+	image.push_back(0xC0);
+
+	Channel channel;
+	Transputer vm(256);
+	vm.loadProgram(image.data(), image.size());
+	vm.setLinkHandlers(handlersFor(channel));
+
+	// Stop half way through the first prefix chain, then let run() finish.
+	vm.tick();
+	EXPECT_EQ(vm.run(100), RunStatus::Halted);
+	ASSERT_EQ(channel.out.size(), 1u);
+	EXPECT_EQ(channel.out[0], 42u);
+	EXPECT_EQ(vm.getTickCount(), image.size());
+}
@@ -0,0 +1,183 @@
+#include <cstdlib>
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+#include "asm.h"
+#include "Translator.h"
+#include "Transputer.h"
+
+#include "test_util.h"
+
+namespace {
+	// Reads n from link 0, then sends 2n, 2(n - 1), ..., 2 through a PROC.
+	const std::string DOUBLER =
+		"ajw 8\n"
+		"ldc -2147483632\n"
+		"ldnl 0\n"
+		"stl 0\n"
+		"loop:\n"
+		"  ldl 0\n"
+		"  cj done:\n"
+		"  ldl 0\n"
+		"  call double:\n"
+		"  ldc -2147483648\n"
+		"  stnl 0\n"
+		"  ldl 0\n"
+		"  adc -1\n"
+		"  stl 0\n"
+		"  j loop:\n"
+		"done:\n"
+		"  j end:\n"
+		"double:\n"
+		"  ldl 1\n"
+		"  ldl 1\n"
+		"  opr add\n"
+		"  opr ret\n"
+		"end:\n";
+
+	/// Builds C++ @source from the translator into a shared object with the
+	/// host compiler, and loads it.
+	std::shared_ptr<const Translation> build(
+	  const std::string& name,
+	  const std::string& source) {
+		const std::string cpp = tempPath("xlat_" + name + ".cpp");
+		const std::string so = tempPath("xlat_" + name + ".so");
+		std::ofstream(cpp, std::ios::trunc) << source;
+
+		const std::string command = std::string(XLAT_CXX) + " -O1 -shared -fPIC -I " +
+			XLAT_ABI_INCLUDE + " " + cpp + " -o " + so;
+		EXPECT_EQ(std::system(command.c_str()), 0) << command;
+
+		return Translation::load(so.c_str());
+	}
+
+	/// Runs @vm with @input arriving only after it first blocks, and returns
+	/// its output.
+	std::vector<u32> runWithLateInput(Transputer& vm, const u32 input) {
+		Channel channel;
+		vm.setLinkHandlers(handlersFor(channel));
+
+		EXPECT_EQ(vm.run(1000), RunStatus::Blocked);
+		channel.in.push_back(input);
+		while (vm.run(5) == RunStatus::BudgetExhausted);
+
+		return channel.out;
+	}
+}
+
+TEST(XlatSuite, MatchesInterpreter) {
+	const std::vector<u8> image = assemble(DOUBLER);
+
+	Transputer interpreted(1024);
+	interpreted.loadProgram(image.data(), image.size());
+	ASSERT_TRUE(interpreted.isVerified()) << interpreted.getVerifyError();
+
+	Transputer translated(1024);
+	translated.loadProgram(image.data(), image.size());
+	translated.attachTranslation(build("doubler", Translator::translate(image)));
+
+	const std::vector<u32> expected = {6, 4, 2};
+	EXPECT_EQ(runWithLateInput(interpreted, 3), expected);
+	EXPECT_EQ(runWithLateInput(translated, 3), expected);
+	EXPECT_EQ(translated.getTickCount(), interpreted.getTickCount());
+	EXPECT_TRUE(translated.isVerified());
+
+	// Resetting keeps the translation attached.
+	translated.reset();
+	EXPECT_EQ(runWithLateInput(translated, 2), (std::vector<u32>{4, 2}));
+}
+
+TEST(XlatSuite, DispatchesToNativeCode) {
+	const std::vector<u8> image = assemble(DOUBLER);
+
+	// Sabotage the translated `opr add`, so that results show which code ran.
+	std::string source = Translator::translate(image);
+	const size_t add = source.find("A = A + B;");
+	ASSERT_NE(add, std::string::npos);
+	source.replace(add, 10, "A = A + B + 100;");
+
+	Transputer vm(1024);
+	vm.loadProgram(image.data(), image.size());
+	vm.attachTranslation(build("sabotaged", source));
+
+	EXPECT_EQ(runWithLateInput(vm, 2), (std::vector<u32>{104, 102}));
+}
+
+TEST(XlatSuite, FaultsOnDivisionByZero) {
+	// Sends 7 / d and 7 \ d for d from link 0.
+	const std::vector<u8> image = assemble(
+		"ajw 8\n"
+		"ldc -2147483632\n"
+		"ldnl 0\n"
+		"stl 0\n"
+		"ldl 0\n"
+		"ldc 7\n"
+		"opr div\n"
+		"ldc -2147483648\n"
+		"stnl 0\n"
+		"ldl 0\n"
+		"ldc 7\n"
+		"opr mod\n"
+		"ldc -2147483648\n"
+		"stnl 0\n");
+	const std::shared_ptr<const Translation> translation =
+		build(testName(), Translator::translate(image));
+
+	for (const bool translated: {false, true}) {
+		Transputer vm(1024);
+		vm.loadProgram(image.data(), image.size());
+		ASSERT_TRUE(vm.isVerified()) << vm.getVerifyError();
+		if (translated) vm.attachTranslation(translation);
+
+		Channel channel;
+		vm.setLinkHandlers(handlersFor(channel));
+		channel.in = {2};
+		EXPECT_EQ(vm.run(1000), RunStatus::Halted);
+		EXPECT_EQ(channel.out, (std::vector<u32>{3, 1}));
+
+		vm.reset();
+		channel = Channel{{0}, {}};
+		EXPECT_THROW(vm.run(1000), BException);
+		EXPECT_TRUE(channel.out.empty());
+	}
+}
+
+TEST(XlatSuite, FallsBackWhenCodeIsWritten) {
+	// As in TransputerSuite.StoresIntoCodeInvalidateDecodedBlocks: the
+	// program patches its own code to send 7 instead of 1.
+	const u32 memSize = 1024;
+	std::vector<u8> image;
+	Assembler::genPrefixSeq(0x6, 0x67000000, image);
+	Assembler::genPrefixSeq(0x6, memSize - 16, image);
+	image.push_back(0xC0);
+	image.insert(image.end(), {0x61, 0x61, 0x61, 0x61, 0xF0, 0xF0, 0xF0});
+	// ldc link0.out; stnl 0
+	image.insert(image.end(), {0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0xC0});
+
+	Channel channel;
+	Transputer vm(memSize);
+	vm.loadProgram(image.data(), image.size());
+	vm.attachTranslation(build("patcher", Translator::translate(image)));
+	vm.setLinkHandlers(handlersFor(channel));
+
+	EXPECT_EQ(vm.run(1000), RunStatus::Halted);
+	ASSERT_EQ(channel.out.size(), 1u);
+	EXPECT_EQ(channel.out[0], 7u);
+	EXPECT_FALSE(vm.isVerified());
+}
+
+TEST(XlatSuite, RejectsOtherImagesAndUnverifiedOnes) {
+	const std::vector<u8> image = assemble(DOUBLER);
+	const auto translation = build("other", Translator::translate(image));
+
+	const std::vector<u8> other = assemble("ldc 1\n");
+	Transputer vm(1024);
+	vm.loadProgram(other.data(), other.size());
+	EXPECT_THROW(vm.attachTranslation(translation), BException);
+
+	// opr 0xF is not an operation the VM knows.
+	EXPECT_THROW(Translator::translate({0x2F}), BException);
+	// An empty image has no blocks to translate.
+	EXPECT_THROW(Translator::translate({}), BException);
+}